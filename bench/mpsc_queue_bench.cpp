@@ -0,0 +1,94 @@
+/*
+ * throughput of bounded_mpsc_queue and mpsc_queue against a mutex guarded
+ * std::deque of any_callable
+ */
+
+#include "src/mpsc_queue.hpp"
+#include <chrono>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr int task_count = 1000000;
+
+class mutex_queue {
+  std::mutex _lock;
+  std::deque<sg::any_callable<void()>> _tasks;
+
+public:
+  template <typename F> void push(F &&f) {
+    std::lock_guard<std::mutex> guard(_lock);
+    _tasks.emplace_back(std::forward<F>(f));
+  }
+  bool try_run_one() {
+    sg::any_callable<void()> task;
+    {
+      std::lock_guard<std::mutex> guard(_lock);
+      if (_tasks.empty())
+        return false;
+      task = std::move(_tasks.front());
+      _tasks.pop_front();
+    }
+    task();
+    return true;
+  }
+};
+
+template <typename Queue, typename F> void push(Queue &queue, F &&f) {
+  queue.push(std::forward<F>(f));
+}
+
+template <std::size_t N, typename F>
+void push(sg::bounded_mpsc_queue<N> &queue, F &&f) {
+  while (!queue.try_push(f))
+    std::this_thread::yield();
+}
+
+template <typename Queue>
+void run(const std::string &name, Queue &queue, int producer_count) {
+  std::size_t sum = 0;
+  int per_producer = task_count / producer_count;
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> producers;
+  for (int p = 0; p < producer_count; p++)
+    producers.emplace_back([&queue, &sum, per_producer] {
+      for (int i = 0; i < per_producer; i++)
+        push(queue, [&sum, i] { sum += i; });
+    });
+  for (int done = 0; done < per_producer * producer_count;) {
+    if (queue.try_run_one())
+      done++;
+    else
+      std::this_thread::yield();
+  }
+  for (auto &t : producers)
+    t.join();
+  std::chrono::duration<double> time = std::chrono::steady_clock::now() - start;
+  std::cout << name << " producers=" << producer_count << " "
+            << static_cast<long>(per_producer * producer_count / time.count())
+            << " tasks/s (checksum " << sum << ")" << std::endl;
+}
+
+} // namespace
+
+int main() {
+  for (int producers : {1, 2, 4, 8}) {
+    {
+      mutex_queue queue;
+      run("mutex deque  ", queue, producers);
+    }
+    {
+      sg::bounded_mpsc_queue<> queue(1024);
+      run("bounded mpsc ", queue, producers);
+    }
+    {
+      sg::mpsc_queue<> queue;
+      run("mpsc         ", queue, producers);
+    }
+  }
+}
@@ -1,61 +1,237 @@
 /*
  * type similar to std::function but move-only and the size of sbo is
- * configurable
+ * configurable. like std::move_only_function the signature can be const, &&
+ * and noexcept qualified
  */
 
 #ifndef UTILS_ANY_CALLABLE_HPP
 #define UTILS_ANY_CALLABLE_HPP
 
 #include <cassert>
+#include <new>
+#include <tuple>
 #include <type_traits>
 #include <utility>
 
 #include "callable_utils.hpp"
 #include "sbo_base.hpp"
+#include "type_id.hpp"
 
 namespace sg {
 
-template <typename Signature, std::size_t = 32, bool = false>
-class any_callable;
+/**
+ * @brief list of signatures for an any_callable that can be invoked in
+ * several ways. the target is stored once and must be invocable with every
+ * signature, the overload is selected at the call site.
+ * @tparam Sigs signatures of the form R(Args...) with optional const, && and
+ * noexcept qualifiers
+ */
+template <typename... Sigs> struct overloads {};
 
-template <typename R, typename... Args, std::size_t sbo_size>
-class any_callable<R(Args...) noexcept, sbo_size>
-    : any_callable<R(Args...), sbo_size, true> {};
+template <typename Signature, std::size_t = 32> class any_callable;
 
-template <typename R, typename... Args, std::size_t sbo_size, bool is_noexcept>
-class any_callable<R(Args...), sbo_size, is_noexcept> : sbo_base<sbo_size> {
-private:
-  using invoke_ptr_type = R (*)(void *, Args...);
-  using destroy_ptr_type = void (*)(void *);
-  using move_ptr_type = void (*)(void *, void *);
-  invoke_ptr_type invoke_ptr = nullptr;
-  destroy_ptr_type destroy_ptr = nullptr;
-  move_ptr_type move_ptr = nullptr;
-  template <typename T> static R invoke_func(void *data, Args... args) {
-    return (*static_cast<T *>(data))(propagate(args)...);
+namespace detail {
+
+/**
+ * @brief invoke entry for one signature.
+ * @tparam is_const the target is invoked as a const lvalue
+ * @tparam is_rvalue the target is invoked as an rvalue and destroyed by the
+ * call, so that consuming it doesn't need a second dispatch
+ * @tparam is_noexcept the target must be nothrow invocable
+ */
+template <bool is_const, bool is_rvalue, bool is_noexcept, typename R,
+          typename... Args>
+struct callable_entry_base {
+  using invoke_ptr_type = R (*)(void *, Args...) noexcept(is_noexcept);
+  using fn_ptr_type = R (*)(Args...);
+  template <typename T>
+  using target_ref =
+      std::conditional_t<is_rvalue, T &&,
+                         std::conditional_t<is_const, const T &, T &>>;
+  template <typename T> static constexpr void check() {
+    // function pointers are checked against the exact signature
+    using checked_type =
+        std::conditional_t<std::is_function_v<std::remove_pointer_t<T>>, T,
+                           target_ref<T>>;
+    (void)sig_asserts<checked_type, R(Args...)>{};
+    static_assert(!is_noexcept ||
+                      std::is_nothrow_invocable_v<target_ref<T>, Args...>,
+                  "signature is noexcept but callable isn't");
+  }
+  template <typename T>
+  static R invoke_func(void *data, Args... args) noexcept(is_noexcept) {
+    T *target = static_cast<T *>(data);
+    if constexpr (is_rvalue) {
+      struct consume {
+        T *target;
+        ~consume() { target->~T(); }
+      } guard{target};
+      return std::move(*target)(std::forward<Args>(args)...);
+    } else
+      return static_cast<target_ref<T>>(*target)(std::forward<Args>(args)...);
+  }
+};
+
+template <typename> struct callable_entry {};
+
+template <typename R, typename... Args, bool is_noexcept>
+struct callable_entry<R(Args...) noexcept(is_noexcept)>
+    : callable_entry_base<false, false, is_noexcept, R, Args...> {};
+
+template <typename R, typename... Args, bool is_noexcept>
+struct callable_entry<R(Args...) const noexcept(is_noexcept)>
+    : callable_entry_base<true, false, is_noexcept, R, Args...> {};
+
+template <typename R, typename... Args, bool is_noexcept>
+struct callable_entry<R(Args...) && noexcept(is_noexcept)>
+    : callable_entry_base<false, true, is_noexcept, R, Args...> {};
+
+template <typename Sig> struct callable_sig_list {
+  using type = overloads<Sig>;
+};
+
+template <typename... Sigs> struct callable_sig_list<overloads<Sigs...>> {
+  using type = overloads<Sigs...>;
+};
+
+/// function pointer type that can be compared against the stored target, void
+/// if there is more than one signature.
+template <typename> struct callable_fn_ptr { using type = void; };
+
+template <typename Sig> struct callable_fn_ptr<overloads<Sig>> {
+  using type = typename callable_entry<Sig>::fn_ptr_type;
+};
+
+/// operations shared by all any_callable storing the same type. there is one
+/// invoke entry per signature.
+template <typename> struct callable_ops {};
+
+template <typename... Sigs> struct callable_ops<overloads<Sigs...>> {
+  std::tuple<typename callable_entry<Sigs>::invoke_ptr_type...> invoke;
+  void (*destroy)(void *) noexcept;
+  void (*move)(void *, void *) noexcept;
+  type_id_t type;
+  std::size_t size;
+  template <typename T> static constexpr callable_ops make() {
+    (callable_entry<Sigs>::template check<T>(), ...);
+    return {{&callable_entry<Sigs>::template invoke_func<T>...},
+            &destroy_func<T>,
+            &move_func<T>,
+            type_id<T>(),
+            sizeof(T)};
+  }
+};
+
+template <typename T, typename SigList>
+inline constexpr callable_ops<SigList> callable_ops_for =
+    callable_ops<SigList>::template make<T>();
+
+/// storage of any_callable, the operations table pointer is part of it.
+template <typename Signature, std::size_t sbo_size>
+using callable_storage =
+    compact_sbo_base<sbo_size,
+                     callable_ops<typename callable_sig_list<Signature>::type>>;
+
+/// release the storage of an any_callable whose target was consumed by an
+/// rvalue call.
+template <typename Derived> struct callable_release {
+  Derived &self;
+  ~callable_release() { self.release(); }
+};
+
+template <typename Derived, std::size_t I, typename Sig>
+struct callable_invoker {};
+
+template <typename Derived, std::size_t I, typename R, typename... Args,
+          bool is_noexcept>
+struct callable_invoker<Derived, I, R(Args...) noexcept(is_noexcept)> {
+  R operator()(Args... args) noexcept(is_noexcept) {
+    Derived &self = static_cast<Derived &>(*this);
+    assert(self.ops());
+    return std::get<I>(self.ops()->invoke)(self.ptr(),
+                                          std::forward<Args>(args)...);
+  }
+};
+
+template <typename Derived, std::size_t I, typename R, typename... Args,
+          bool is_noexcept>
+struct callable_invoker<Derived, I, R(Args...) const noexcept(is_noexcept)> {
+  R operator()(Args... args) const noexcept(is_noexcept) {
+    const Derived &self = static_cast<const Derived &>(*this);
+    assert(self.ops());
+    return std::get<I>(self.ops()->invoke)(self.ptr(),
+                                          std::forward<Args>(args)...);
   }
-  template <typename T> static void destroy_func(void *data) {
-    static_cast<T *>(data)->~T();
+};
+
+template <typename Derived, std::size_t I, typename R, typename... Args,
+          bool is_noexcept>
+struct callable_invoker<Derived, I, R(Args...) && noexcept(is_noexcept)> {
+  R operator()(Args... args) && noexcept(is_noexcept) {
+    Derived &self = static_cast<Derived &>(*this);
+    assert(self.ops());
+    callable_release<Derived> release{self};
+    return std::get<I>(self.ops()->invoke)(self.ptr(),
+                                          std::forward<Args>(args)...);
   }
-  template <typename T> static void move_func(void *from, void *to) {
-    new (to) T(std::move(*static_cast<T *>(from)));
+};
+
+template <typename Derived, typename Indexes, typename SigList>
+struct callable_invokers {};
+
+template <typename Derived, std::size_t... I, typename... Sigs>
+struct callable_invokers<Derived, std::index_sequence<I...>,
+                         overloads<Sigs...>>
+    : callable_invoker<Derived, I, Sigs>... {
+  using callable_invoker<Derived, I, Sigs>::operator()...;
+};
+
+template <typename Derived, typename SigList> struct callable_invokers_for {};
+
+template <typename Derived, typename... Sigs>
+struct callable_invokers_for<Derived, overloads<Sigs...>> {
+  using type = callable_invokers<Derived, std::index_sequence_for<Sigs...>,
+                                 overloads<Sigs...>>;
+};
+
+} // namespace detail
+
+template <typename Signature, std::size_t sbo_size>
+class any_callable
+    : detail::callable_storage<Signature, sbo_size>,
+      public detail::callable_invokers_for<
+          any_callable<Signature, sbo_size>,
+          typename detail::callable_sig_list<Signature>::type>::type {
+private:
+  using sig_list = typename detail::callable_sig_list<Signature>::type;
+  using ops_type = detail::callable_ops<sig_list>;
+  using storage_type = detail::callable_storage<Signature, sbo_size>;
+  using fn_ptr_type = typename detail::callable_fn_ptr<sig_list>::type;
+  template <typename, std::size_t, typename>
+  friend struct detail::callable_invoker;
+  template <typename> friend struct detail::callable_release;
+  template <typename, std::size_t> friend class any_callable;
+  template <typename T>
+  static constexpr const ops_type *ops_for() noexcept {
+    return &detail::callable_ops_for<T, sig_list>;
   }
   template <typename T> void setup(T &&invokale) {
-    sig_asserts<typename std::decay<T>::type, R(Args...)> check;
-    static_assert(std::is_nothrow_move_constructible_v<T>);
     using inplace_type = std::decay_t<T>;
+    static_assert(std::is_nothrow_move_constructible_v<inplace_type>);
+    static_assert(alignof(inplace_type) <= alignof(std::max_align_t),
+                  "heap blocks aren't aligned for over-aligned callables");
 
-    if (!this->alloc(sizeof(inplace_type)))
+    if (!this->alloc(sizeof(inplace_type), alignof(inplace_type)))
       throw std::bad_alloc();
     new (this->ptr()) inplace_type(std::forward<T>(invokale));
-    invoke_ptr = invoke_func<inplace_type>;
-    destroy_ptr = destroy_func<inplace_type>;
-    move_ptr = move_func<inplace_type>;
+    this->set_ops(ops_for<inplace_type>());
   }
-  void destroy() {
+  /// the heap block is kept so that the next target can reuse it.
+  void release() noexcept { this->clear(); }
+  void destroy() noexcept {
     if (!this->is_empty()) {
-      destroy_ptr(this->ptr());
-      this->free();
+      this->ops()->destroy(this->ptr());
+      this->clear();
     }
   }
   template <typename T> void move_to_self(T &&other) noexcept {
@@ -66,24 +242,35 @@ private:
                   "noexcept can't be garenteed");
     // because sbo can be to small for the current type but fit in the other
     // type so allocation could be necessary and fail
-    this->_size = other._size;
-    invoke_ptr = other.invoke_ptr;
-    destroy_ptr = other.destroy_ptr;
-    move_ptr = other.move_ptr;
+    if (other.is_empty())
+      return;
+    const ops_type *ops = other.ops();
     if (other.is_sbo()) {
-      void *ptr = this->alloc(other.size());
-      assert(ptr && "shouldn't fail as object fits in sbo");
-      move_ptr(other.ptr(), ptr);
-    } else {
-      this->_alloced_ptr = other._alloced_ptr;
-    }
-    other._size = 0;
-    other.invoke_ptr = nullptr;
+      // the target fits in the sbo of other so it fits in this one
+      void *ptr = this->alloc_sbo();
+      ops->move(other.ptr(), ptr);
+      ops->destroy(other.ptr());
+      other.clear();
+      this->set_ops(ops);
+    } else
+      this->steal(other);
+  }
+  template <typename Ret, typename F, typename Self>
+  static Ret visit_impl(Self &self, F &f) {
+    return f(self);
+  }
+  template <typename Ret, typename F, typename T, typename... Ts,
+            typename Self>
+  static Ret visit_impl(Self &self, F &f) {
+    if (auto *target = self.template target<T>())
+      return f(*target);
+    return visit_impl<Ret, F, Ts...>(self, f);
   }
 
 public:
   template <typename T>
-  constexpr static bool fit_sbo = sizeof(std::decay_t<T>) <= sbo_size;
+  constexpr static bool fit_sbo = storage_type::fits(
+      sizeof(std::decay_t<T>), alignof(std::decay_t<T>));
   constexpr static std::size_t buff_size = sbo_size;
   any_callable() = default;
   template <
@@ -99,7 +286,7 @@ public:
           !sg::is_instance_of<std::decay_t<T>, any_callable>::value, int> = 0>
   any_callable &operator=(T &&invokale) {
     destroy();
-    setup(std::forward(invokale));
+    setup(std::forward<T>(invokale));
     return (*this);
   }
   template <
@@ -118,75 +305,150 @@ public:
     move_to_self(std::forward<T>(other));
     return (*this);
   }
-  R operator()(Args... args) const noexcept(is_noexcept) {
-    assert(invoke_ptr);
-    return invoke_ptr(this->ptr(), propagate(args)...);
+  /**
+   * @brief return a pointer on the target if it is a T, nullptr otherwise.
+   * the check is a single compare against the operations of T
+   */
+  template <typename T> [[nodiscard]] T *target() noexcept {
+    if (this->ops() == ops_for<T>())
+      return static_cast<T *>(this->ptr());
+    return nullptr;
+  }
+  template <typename T> [[nodiscard]] const T *target() const noexcept {
+    if (this->ops() == ops_for<T>())
+      return static_cast<const T *>(this->ptr());
+    return nullptr;
+  }
+  /// type_id of the target or type_id<void>() if empty.
+  [[nodiscard]] type_id_t target_type() const noexcept {
+    return this->ops() ? this->ops()->type : type_id<void>();
+  }
+  /**
+   * @brief call f with a reference on the target if it is one of Ts, with
+   * *this otherwise. f is instantiated for each known type so calls to the
+   * target can be inlined, this allows to hoist the type check out of loops
+   * @tparam Ts known types to check against, in order
+   * @param f callable invocable with Ts&... and any_callable&
+   */
+  template <typename... Ts, typename F> decltype(auto) visit(F &&f) {
+    return visit_impl<std::invoke_result_t<F &, any_callable &>, F, Ts...>(
+        *this, f);
+  }
+  template <typename... Ts, typename F> decltype(auto) visit(F &&f) const {
+    return visit_impl<std::invoke_result_t<F &, const any_callable &>, F,
+                      Ts...>(*this, f);
   }
-  [[nodiscard]] explicit operator bool() const noexcept { return invoke_ptr; }
-  [[nodiscard]] bool is_empty() const noexcept { return invoke_ptr == nullptr; }
+  /// call the target directly if it is a T and through the operations table
+  /// otherwise.
+  template <typename T, typename... As>
+  decltype(auto) invoke_as(As &&... as) & {
+    using result = std::invoke_result_t<any_callable &, As...>;
+    return visit<T>([&](auto &target) -> result {
+      return target(std::forward<As>(as)...);
+    });
+  }
+  template <typename T, typename... As>
+  decltype(auto) invoke_as(As &&... as) const & {
+    using result = std::invoke_result_t<const any_callable &, As...>;
+    return visit<T>([&](auto &target) -> result {
+      return target(std::forward<As>(as)...);
+    });
+  }
+  /**
+   * @brief rvalue call. the target is always destroyed, even if the type
+   * doesn't match and the signature used isn't && qualified, so the
+   * any_callable is left empty like after a call with a && signature
+   */
+  template <typename T, typename... As>
+  decltype(auto) invoke_as(As &&... as) && {
+    using result = std::invoke_result_t<any_callable &&, As...>;
+    struct consume {
+      any_callable &self;
+      ~consume() { self.destroy(); }
+    } guard{*this};
+    return visit<T>([&](auto &target) -> result {
+      if constexpr (std::is_same_v<std::decay_t<decltype(target)>,
+                                   any_callable>)
+        return std::move(target)(std::forward<As>(as)...);
+      else
+        return std::move(static_cast<T &>(target))(std::forward<As>(as)...);
+    });
+  }
+  /// release the heap block kept after the target was destroyed, or move a
+  /// heap target to a block of its size.
+  void shrink_to_fit() noexcept {
+    storage_type::shrink_to_fit([this](void *from, void *to) {
+      this->ops()->move(from, to);
+      this->ops()->destroy(from);
+    });
+  }
+  /// number of bytes a target can use without allocating.
+  [[nodiscard]] std::size_t capacity() const noexcept {
+    return storage_type::capacity();
+  }
+  [[nodiscard]] explicit operator bool() const noexcept {
+    return this->ops();
+  }
+  [[nodiscard]] bool is_empty() const noexcept { return !this->ops(); }
   template <
       typename T,
       std::enable_if_t<sg::is_instance_of<std::decay_t<T>, any_callable>::value,
                        int> = 0>
   [[nodiscard]] bool operator==(const T &other) const noexcept {
-    if (invoke_ptr == &invoke_func<R (*)(Args...)> &&
-        other.invoke_ptr == invoke_ptr) {
-      return (*reinterpret_cast<R (**)(Args...)>(this->ptr())) ==
-             (*reinterpret_cast<R (**)(Args...)>(other.ptr()));
-    } else
-      return invoke_ptr == other.invoke_ptr;
+    if constexpr (!std::is_void_v<fn_ptr_type>) {
+      if (this->ops() == ops_for<fn_ptr_type>() &&
+          other.ops() == this->ops())
+        return (*reinterpret_cast<fn_ptr_type *>(this->ptr())) ==
+               (*reinterpret_cast<fn_ptr_type *>(other.ptr()));
+    }
+    return static_cast<const void *>(this->ops()) ==
+           static_cast<const void *>(other.ops());
   }
   template <
       typename T,
       std::enable_if_t<
           !sg::is_instance_of<std::decay_t<T>, any_callable>::value, int> = 0>
-  [[nodiscard]] friend bool
-  operator==(const any_callable<R(Args...), sbo_size> &first,
-             const T &value) noexcept {
-    sig_asserts<typename std::decay<T>::type, R(Args...)> check;
-    static_assert(std::is_nothrow_move_constructible_v<T>);
+  [[nodiscard]] friend bool operator==(const any_callable &first,
+                                       const T &value) noexcept {
     using inplace_type = std::decay_t<T>;
+    static_assert(std::is_nothrow_move_constructible_v<inplace_type>);
 
-    if constexpr (std::is_constructible_v<inplace_type, R (*)(Args...)>) {
-      if (first.invoke_ptr == &invoke_func<R (*)(Args...)>)
-        return (*reinterpret_cast<R (**)(Args...)>(first.ptr())) ==
-               static_cast<R (*)(Args...)>(value);
+    if constexpr (!std::is_void_v<fn_ptr_type> &&
+                  std::is_constructible_v<inplace_type, fn_ptr_type>) {
+      if (first.ops() == ops_for<fn_ptr_type>())
+        return (*reinterpret_cast<fn_ptr_type *>(first.ptr())) ==
+               static_cast<fn_ptr_type>(value);
     }
-    return first.invoke_ptr == &invoke_func<inplace_type>;
+    return first.ops() == ops_for<inplace_type>();
   }
   template <
       typename T,
       std::enable_if_t<
           !sg::is_instance_of<std::decay_t<T>, any_callable>::value, int> = 0>
-  [[nodiscard]] friend bool
-  operator==(const T &value,
-             const any_callable<R(Args...), sbo_size> &first) noexcept {
+  [[nodiscard]] friend bool operator==(const T &value,
+                                       const any_callable &first) noexcept {
     return (first == value);
   }
   template <typename T>
-  [[nodiscard]] friend bool
-  operator!=(const any_callable<R(Args...), sbo_size> &first,
-             const T &value) noexcept {
+  [[nodiscard]] friend bool operator!=(const any_callable &first,
+                                       const T &value) noexcept {
     return !(first == value);
   }
   template <
       typename T,
       std::enable_if_t<
           !sg::is_instance_of<std::decay_t<T>, any_callable>::value, int> = 0>
-  [[nodiscard]] friend bool
-  operator!=(const T &value,
-             const any_callable<R(Args...), sbo_size> &first) noexcept {
+  [[nodiscard]] friend bool operator!=(const T &value,
+                                       const any_callable &first) noexcept {
     return !(first == value);
   }
-  [[nodiscard]] friend bool
-  operator==(const any_callable<R(Args...), sbo_size> &first,
-             std::nullptr_t) noexcept {
-    return first.invoke_ptr == nullptr;
+  [[nodiscard]] friend bool operator==(const any_callable &first,
+                                       std::nullptr_t) noexcept {
+    return first.is_empty();
   }
-  [[nodiscard]] friend bool
-  operator==(std::nullptr_t,
-             const any_callable<R(Args...), sbo_size> &first) noexcept {
-    return first.invoke_ptr == nullptr;
+  [[nodiscard]] friend bool operator==(std::nullptr_t,
+                                       const any_callable &first) noexcept {
+    return first.is_empty();
   }
   any_callable(any_callable &) = delete;
   any_callable &operator=(any_callable &) = delete;
@@ -195,4 +457,4 @@ public:
 
 } // namespace sg
 
-#endif
\ No newline at end of file
+#endif
@@ -6,37 +6,96 @@
 #define UTILS_CALLABLE_REF_HPP
 
 #include <cassert>
+#include <functional>
 #include <memory>
 #include <type_traits>
 
 #include "callable_utils.hpp"
+#include "span.hpp"
 
 namespace sg {
 
 template <typename> class any_callable_ref {};
 
 template <typename R, typename... Args> class any_callable_ref<R(Args...)> {
+public:
+  using fn_ptr_type = R (*)(Args...);
+
 protected:
-  R (*call_ptr)(void *, Args...) = nullptr;
-  void *data = nullptr;
+  /// the referenced object, or the function itself for function pointers so
+  /// that calling it doesn't need to load the pointer from memory.
+  union storage {
+    void *obj;
+    fn_ptr_type fn;
+  };
+  R (*call_ptr)(storage, Args...) = nullptr;
+  storage data{nullptr};
+
+  any_callable_ref(R (*call)(storage, Args...), storage st) noexcept
+      : call_ptr{call}, data{st} {}
+  template <typename F, typename... Ts> static R invoke_r(F &&f, Ts &&... ts) {
+    if constexpr (std::is_same_v<R, void>)
+      std::invoke(std::forward<F>(f), std::forward<Ts>(ts)...);
+    else
+      return std::invoke(std::forward<F>(f), std::forward<Ts>(ts)...);
+  }
+  template <typename T> static R call_object(storage st, Args... args) {
+    return invoke_r(*static_cast<T *>(st.obj), sg::propagate(args)...);
+  }
+  static R call_fn_ptr(storage st, Args... args) {
+    return st.fn(sg::propagate(args)...);
+  }
+  template <auto F> static R call_bound(storage, Args... args) {
+    return invoke_r(F, sg::propagate(args)...);
+  }
+  template <auto F, typename T>
+  static R call_bound_to(storage st, Args... args) {
+    return invoke_r(F, *static_cast<T *>(st.obj), sg::propagate(args)...);
+  }
+  template <typename Callable>
+  static constexpr bool is_fn =
+      std::is_function_v<std::remove_pointer_t<std::decay_t<Callable>>>;
 
 public:
   any_callable_ref() noexcept = default;
-  template <
-      typename Callable,
-      typename std::enable_if_t<
-          !std::is_same_v<std::decay_t<Callable>, any_callable_ref>, int> = 0>
+  template <typename Callable,
+            typename std::enable_if_t<
+                !std::is_same_v<std::decay_t<Callable>, any_callable_ref> &&
+                    !is_fn<Callable>,
+                int> = 0>
   explicit any_callable_ref(Callable &&func) noexcept {
-    sig_asserts<typename std::decay<Callable>::type, R(Args...)> check;
-    data = reinterpret_cast<void *>(std::addressof(func));
-    call_ptr = [](void *func, Args... args) -> R {
-      if constexpr (std::is_same_v<R, void>)
-        (*reinterpret_cast<std::remove_reference_t<Callable> *>(func))(
-            sg::propagate(args)...);
-      else
-        return (*reinterpret_cast<std::remove_reference_t<Callable> *>(func))(
-            sg::propagate(args)...);
-    };
+    (void)sig_asserts<typename std::decay<Callable>::type, R(Args...)>{};
+    data.obj = const_cast<void *>(
+        static_cast<const void *>(std::addressof(func)));
+    call_ptr = &call_object<std::remove_reference_t<Callable>>;
+  }
+  /// fn is stored by value, there is no pointer to keep alive.
+  any_callable_ref(fn_ptr_type fn) noexcept {
+    assert(fn);
+    data.fn = fn;
+    call_ptr = &call_fn_ptr;
+  }
+  /**
+   * @brief reference on a function known at compile time, the call goes
+   * directly to F
+   */
+  template <auto F> static any_callable_ref bind() noexcept {
+    static_assert(std::is_invocable_r_v<R, decltype(F), Args...>,
+                  "signature and callable don't match");
+    return any_callable_ref(&call_bound<F>, storage{nullptr});
+  }
+  /**
+   * @brief reference on obj with a function or member function known at
+   * compile time, calls are std::invoke(F, obj, args...)
+   */
+  template <auto F, typename T>
+  static any_callable_ref bind(T &obj) noexcept {
+    static_assert(std::is_invocable_r_v<R, decltype(F), T &, Args...>,
+                  "signature and callable don't match");
+    return any_callable_ref(
+        &call_bound_to<F, T>,
+        storage{const_cast<void *>(
+            static_cast<const void *>(std::addressof(obj)))});
   }
   any_callable_ref(const any_callable_ref &) noexcept = default;
   template <
@@ -49,7 +108,11 @@ public:
   }
   any_callable_ref &operator=(const any_callable_ref &) noexcept = default;
   bool operator==(any_callable_ref other) const noexcept {
-    return call_ptr == other.call_ptr && data == other.data;
+    if (call_ptr != other.call_ptr)
+      return false;
+    if (call_ptr == &call_fn_ptr)
+      return data.fn == other.data.fn;
+    return data.obj == other.data.obj;
   }
   template <
       typename Callable,
@@ -61,15 +124,76 @@ public:
   template <typename T> bool operator!=(T &&other) const noexcept {
     return !(*this == std::forward<T>(other));
   }
+  /**
+   * @brief return a pointer on the referenced object if it is a T, nullptr
+   * otherwise. a reference built from a T and one built from a const T are
+   * both found by target<const T>
+   */
+  template <typename T> T *target() const noexcept {
+    if constexpr (std::is_invocable_r_v<R, T &, Args...>) {
+      if (call_ptr == &call_object<T>)
+        return static_cast<T *>(data.obj);
+      if constexpr (std::is_const_v<T>)
+        if (call_ptr == &call_object<std::remove_const_t<T>>)
+          return static_cast<T *>(data.obj);
+    }
+    return nullptr;
+  }
   R operator()(Args... args) const {
     assert(call_ptr);
-    assert(data);
     return call_ptr(data, propagate(args)...);
   }
   operator bool() const noexcept { return call_ptr; }
   ~any_callable_ref() noexcept = default;
 };
 
+namespace detail {
+
+template <typename Ret, typename Ref, typename F>
+Ret with_known_impl(const Ref &ref, F &f) {
+  return f(ref);
+}
+
+template <typename Ret, typename Ref, typename F, typename T, typename... Ts>
+Ret with_known_impl(const Ref &ref, F &f) {
+  if (T *target = ref.template target<T>())
+    return f(*target);
+  if (const T *target = ref.template target<const T>())
+    return f(*target);
+  return with_known_impl<Ret, Ref, F, Ts...>(ref, f);
+}
+
+} // namespace detail
+
+/**
+ * @brief call f with the object referenced by ref if it is one of Ts, or with
+ * ref itself otherwise. the type is found by comparing the trampoline
+ * address, so code that f instantiates for a known type, like a sort with a
+ * known comparator, calls the target directly and can inline it
+ * @return the result of f, every instantiation of f must return the same type
+ */
+template <typename... Ts, typename Ref, typename F>
+decltype(auto) with_known(const Ref &ref, F &&f) {
+  using ret_type = decltype(f(ref));
+  return detail::with_known_impl<ret_type, Ref, F, Ts...>(ref, f);
+}
+
+/**
+ * @brief call f on consecutive batches of at most batch_size elements of s,
+ * so the indirect call is paid once per batch instead of once per element
+ */
+template <typename T>
+void for_each_span(span<T> s, any_callable_ref<void(span<T>)> f,
+                   std::size_t batch_size = 256) {
+  assert(batch_size && "batch_size must not be 0");
+  while (s.size() > batch_size) {
+    f(s.first(batch_size));
+    s = s.subspan(batch_size);
+  }
+  if (!s.empty())
+    f(s);
+}
+
 } // namespace sg
 
 #endif // UTILS_CALLABLE_REF_HPP
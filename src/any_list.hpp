@@ -6,61 +6,171 @@
 #ifndef SG_ANY_LIST_H
 #define SG_ANY_LIST_H
 
+#include <algorithm>
 #include <cassert>
+#include <cstddef>
 #include <iterator>
-#include <memory>
+#include <new>
 #include <type_traits>
-#include <typeindex>
-#include <typeinfo>
 #include <utility>
+#include <vector>
+
+#include "type_id.hpp"
 
 namespace sg {
 
+template <typename> class any_list_hook;
+
 class any_list {
   template <typename> struct node;
   class itrerator;
   struct node_base {
   private:
-    struct deleter {
-      void operator()(node_base *base) { base->destroy(); }
-    };
-    using ptr_type = std::unique_ptr<node_base, deleter>;
-    std::type_index _idx;
-    ptr_type _next;
-    node_base *_prev;
+    type_id_t _type;
+    node_base *_next = nullptr;
+    node_base *_prev = nullptr;
+    /// frees an owned node, nullptr if it can be freed without running a
+    /// destructor. for a hook, release_hook while linked and nullptr after.
     void (*_deleter)(node_base *);
-    void (*_copy)(node_base *, node_base *);
-    void destroy() { _deleter(this); }
     template <typename T>
-    node_base(T &&, node_base *prev, node_base::ptr_type next)
-        : _idx{typeid(T)}, _next{std::move(next)}, _prev{prev} {
-      _deleter = [](node_base *base) { delete (base->get_as<T>()); };
+    node_base(std::in_place_type_t<T>, void (*deleter)(node_base *)) noexcept
+        : _type{type_id<T>()}, _deleter{deleter} {}
+    /// free the node and its data, or mark a hook as unlinked.
+    static void destroy(node_base *base) noexcept {
+      if (base->_deleter)
+        base->_deleter(base);
+      else
+        ::operator delete(base);
+    }
+    static void release_hook(node_base *base) noexcept {
+      base->_deleter = nullptr;
+    }
+    template <typename T> static constexpr bool is_hooked() {
+      return std::is_base_of_v<any_list_hook<T>, T>;
     }
     template <typename T> node<T> *get_as() {
       return static_cast<node<T> *>(this);
     }
     template <typename T> const node<T> *get_as() const {
-      return static_cast<node<T> *>(this);
+      return static_cast<const node<T> *>(this);
+    }
+    template <typename T> T &data() noexcept {
+      if constexpr (is_hooked<T>())
+        return static_cast<T &>(static_cast<any_list_hook<T> &>(*this));
+      else
+        return get_as<T>()->_data;
+    }
+    template <typename T> const T &data() const noexcept {
+      if constexpr (is_hooked<T>())
+        return static_cast<const T &>(
+            static_cast<const any_list_hook<T> &>(*this));
+      else
+        return get_as<T>()->_data;
     }
 
   public:
-    template <typename T> bool constexpr check() const {
-      return (_idx.hash_code() == typeid(T).hash_code() && _idx == typeid(T));
+    /// single compare of the stored type_id, doesn't need rtti.
+    template <typename T> bool constexpr check() const noexcept {
+      return _type == type_id<T>();
+    }
+    type_id_t type() const noexcept { return _type; }
+    /// sg::type_index of the type, found through the type_id.
+    std::size_t index() const noexcept { return sg::type_index(_type); }
+    template <typename T> T &as() noexcept {
+      assert(check<T>() && "bad type");
+      return data<T>();
+    }
+    template <typename T> const T &as() const noexcept {
+      assert(check<T>() && "bad type");
+      return data<T>();
+    }
+    /// pointer on the data if it is a T, nullptr otherwise.
+    template <typename T> T *get_if() noexcept {
+      return check<T>() ? &data<T>() : nullptr;
+    }
+    template <typename T> const T *get_if() const noexcept {
+      return check<T>() ? &data<T>() : nullptr;
     }
-    template <typename T> T &as() { return get_as<T>()->_data; }
-    template <typename T> const T &as() const { return get_as<T>()->_data; }
     friend class any_list;
+    friend class any_list_index;
+    template <typename> friend class any_list_hook;
   };
   template <typename T> struct node : node_base {
+    static_assert(!is_hooked<T>(),
+                  "types with an any_list_hook are linked, not emplaced");
     T _data;
     template <typename... F>
-    node(node_base *prev, node_base::ptr_type next, F &&... data)
-        : node_base(T(std::forward<F>(data)...), prev, std::move(next)),
+    node(F &&... data)
+        : node_base(std::in_place_type<T>, deleter()),
           _data{std::forward<F>(data)...} {}
+    static constexpr void (*deleter())(node_base *) {
+      if constexpr (std::is_trivially_destructible_v<T> &&
+                    alignof(node) <= __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+        return nullptr;
+      else
+        return [](node_base *base) { delete (base->get_as<T>()); };
+    }
   };
-  node_base::ptr_type _begin;
-  node_base *_end;
-  static node_base::ptr_type null() { return {nullptr}; }
+  node_base *_begin = nullptr;
+  node_base *_end = nullptr;
+  /// number of times nodes were linked or unlinked, any_list_index checks
+  /// it to find out that it is out of date.
+  std::size_t _modifications = 0;
+  template <typename> friend class any_list_hook;
+  friend class any_list_index;
+
+  template <typename F> using visit_thunk = void (*)(node_base &, F &);
+  template <typename F, typename T>
+  static void visit_thunk_for(node_base &base, F &f) {
+    f(base.data<T>());
+  }
+  /// table from type_index to the call of f for the type, shared by the
+  /// calls of visit_all with the same types and visitor.
+  template <typename F, typename... Ts>
+  static const std::vector<visit_thunk<F>> &visit_table() {
+    static const std::vector<visit_thunk<F>> table = [] {
+      std::vector<visit_thunk<F>> out(
+          std::max({sg::type_index<Ts>()...}) + 1);
+      ((out[sg::type_index<Ts>()] = &visit_thunk_for<F, Ts>), ...);
+      return out;
+    }();
+    return table;
+  }
+
+  /// insert the chain [first, last] before pos, or at the end if pos is
+  /// nullptr.
+  void link_before(node_base *pos, node_base *first,
+                   node_base *last) noexcept {
+    node_base *prev = pos ? pos->_prev : _end;
+    _modifications++;
+    first->_prev = prev;
+    last->_next = pos;
+    (prev ? prev->_next : _begin) = first;
+    (pos ? pos->_prev : _end) = last;
+  }
+  /// remove the chain [first, last] from the list without freeing it.
+  void unlink(node_base *first, node_base *last) noexcept {
+    _modifications++;
+    (first->_prev ? first->_prev->_next : _begin) = last->_next;
+    (last->_next ? last->_next->_prev : _end) = first->_prev;
+    first->_prev = nullptr;
+    last->_next = nullptr;
+  }
+  template <typename T, typename... Ts>
+  void emplace_before(node_base *pos, Ts &&... ts) {
+    node_base *tmp = new node<T>(std::forward<Ts>(ts)...);
+    link_before(pos, tmp, tmp);
+  }
+  template <typename T> void link_hook_before(node_base *pos, T &obj) {
+    any_list_hook<T> &hook = obj;
+    assert(!hook.is_linked() && "object already in a list");
+    hook._deleter = &node_base::release_hook;
+    link_before(pos, &hook, &hook);
+  }
+  void erase(node_base *ptr) noexcept {
+    unlink(ptr, ptr);
+    node_base::destroy(ptr);
+  }
 
 public:
   class iterator {
@@ -81,11 +191,11 @@ public:
     const node_base &operator*() const { return (*_ptr); }
     const node_base *operator->() const { return (_ptr); }
     iterator &operator++() {
-      _ptr = _ptr->_next.get();
+      _ptr = _ptr->_next;
       return (*this);
     }
     iterator operator++(int) {
-      _ptr = _ptr->_next.get();
+      _ptr = _ptr->_next;
       return (*this);
     }
     iterator &operator--() {
@@ -101,69 +211,41 @@ public:
     operator bool() const { return _ptr; }
     ~iterator() noexcept = default;
     friend class any_list;
+    friend class any_list_index;
   };
   using const_iterator = const iterator;
-  any_list() : _begin{nullptr}, _end{nullptr} {}
-  template <typename T, typename... Ts> void emplace_back(Ts &&... ts) {
-    node_base::ptr_type tmp =
-        node_base::ptr_type(new node<T>(_end, null(), std::forward<Ts>(ts)...));
-    if (_begin == nullptr) {
-      assert(!_end);
-      _begin = std::move(tmp);
-      _end = _begin.get();
-      return;
-    } else {
-      assert(_end);
-      _end->_next = std::move(tmp);
-      _end = _end->_next.get();
+  any_list() = default;
+  any_list(const any_list &) = delete;
+  any_list &operator=(const any_list &) = delete;
+  any_list(any_list &&other) noexcept
+      : _begin{std::exchange(other._begin, nullptr)},
+        _end{std::exchange(other._end, nullptr)} {
+    other._modifications++;
+  }
+  any_list &operator=(any_list &&other) noexcept {
+    if (this != &other) {
+      clear();
+      _begin = std::exchange(other._begin, nullptr);
+      _end = std::exchange(other._end, nullptr);
+      other._modifications++;
     }
+    return *this;
+  }
+  template <typename T, typename... Ts> void emplace_back(Ts &&... ts) {
+    emplace_before<T>(nullptr, std::forward<Ts>(ts)...);
   }
   template <typename T, typename... Ts> void emplace_front(Ts &&... ts) {
-    node_base::ptr_type tmp = node_base::ptr_type(
-        new node<T>(nullptr, _begin, std::forward<Ts>(ts)...));
-    if (_begin == nullptr) {
-      assert(!_end);
-      _begin = std::move(tmp);
-      _end = _begin.get();
-      return;
-    } else {
-      assert(_end);
-      _begin = std::move(tmp);
-      if (_begin->_next)
-        _begin->_next->_prev = _begin.get();
-    }
+    emplace_before<T>(_begin, std::forward<Ts>(ts)...);
   }
   template <typename T, typename... Ts>
   void emplace_next(const_iterator it, Ts &&... ts) {
     assert(it);
-    assert(_begin);
-    assert(_end);
-    node_base *ptr = it._ptr;
-    node_base::ptr_type tmp = node_base::ptr_type(
-        new node<T>(ptr, std::move(ptr->_next), std::forward<Ts>(ts)...));
-    ptr->_next = std::move(tmp);
-    if (ptr->_next->_next)
-      ptr->_next->_next->_prev = ptr->_next.get();
-    else
-      _end = ptr->_next.get();
+    emplace_before<T>(it._ptr->_next, std::forward<Ts>(ts)...);
   }
   template <typename T, typename... Ts>
   void emplace_prev(const_iterator it, Ts &&... ts) {
     assert(it);
-    assert(_begin);
-    assert(_end);
-    node_base *ptr = it._ptr;
-    if (ptr->_prev) {
-      node_base::ptr_type tmp = node_base::ptr_type(new node<T>(
-          ptr->_prev, std::move(ptr->_prev->_next), std::forward<Ts>(ts)...));
-      ptr->_prev->_next = std::move(tmp);
-      ptr->_prev = ptr->_prev->_next.get();
-    } else {
-      node_base::ptr_type tmp = node_base::ptr_type(
-          new node<T>(nullptr, std::move(_begin), std::forward<Ts>(ts)...));
-      _begin = std::move(tmp);
-      _begin->_next->_prev = _begin.get();
-    }
+    emplace_before<T>(it._ptr, std::forward<Ts>(ts)...);
   }
   template <typename T> void push_front(T &&elem) {
     emplace_front<
@@ -194,83 +276,203 @@ public:
   template <typename T>[[nodiscard]] T &front() {
     assert(_begin);
     assert(_end);
-    return _begin->get_as<T>()->_data;
+    return _begin->as<T>();
   }
   template <typename T>[[nodiscard]] T &back() {
     assert(_begin);
     assert(_end);
-    return _end->get_as<T>()->_data;
+    return _end->as<T>();
   }
   void pop_front() {
     assert(_begin);
-    assert(_end);
-    _begin = std::move(_begin->_next);
-    if (_begin)
-      _begin->_prev = nullptr;
-    else
-      _end = nullptr;
+    erase(_begin);
   }
   void pop_back() {
-    assert(_begin);
     assert(_end);
-    _end = _end->_prev;
-    if (_end)
-      _end->_next = null();
-    else
-      _begin = null();
+    erase(_end);
   }
   void pop_next(iterator it) {
     assert(it);
-    assert(_begin);
-    assert(_end);
     assert(it._ptr->_next);
-    node_base *ptr = it._ptr;
-    ptr->_next = std::move(ptr->_next->_next);
-    if (ptr->_next)
-      ptr->_next->_prev = ptr;
-    else
-      _end = ptr->_next.get();
+    erase(it._ptr->_next);
   }
   void pop_prev(iterator it) {
     assert(it);
-    assert(_begin);
-    assert(_end);
     assert(it._ptr->_prev);
-    node_base *ptr = it._ptr;
-    if (ptr->_prev->_prev) {
-      node_base::ptr_type tmp = std::move(ptr->_prev->_prev->_next);
-      tmp->_prev->_next = std::move(tmp->_next);
-      ptr->_prev = tmp->_prev;
-    } else {
-      _begin = std::move(ptr->_prev->_next);
-      _begin->_next->_prev = _begin.get();
-    }
+    erase(it._ptr->_prev);
   }
   void pop(iterator it) {
-    assert(_begin);
-    assert(_end);
     assert(it);
-    if (it->_next)
-      pop_prev(++it);
-    else if (it->_prev)
-      pop_next(--it);
-    else
-      clear();
+    erase(it._ptr);
+  }
+  /**
+   * @brief link obj, whose type derives from any_list_hook, at the end. it
+   * doesn't allocate and obj must outlive its membership of the list
+   */
+  template <typename T> void link_back(T &obj) {
+    link_hook_before(nullptr, obj);
+  }
+  template <typename T> void link_front(T &obj) {
+    link_hook_before(_begin, obj);
+  }
+  template <typename T> void link_next(iterator it, T &obj) {
+    assert(it);
+    link_hook_before(it._ptr->_next, obj);
   }
+  template <typename T> void link_prev(iterator it, T &obj) {
+    assert(it);
+    link_hook_before(it._ptr, obj);
+  }
+  /// remove obj, which must be linked in this list, without destroying it.
+  /// pop_* and clear also unlink hooked objects instead of freeing them.
+  template <typename T> void unlink(T &obj) noexcept {
+    any_list_hook<T> &hook = obj;
+    assert(hook.is_linked() && "object not in a list");
+    erase(&hook);
+  }
+  /**
+   * @brief move the nodes of [first, last) from other before pos, or at the
+   * end if pos is end(). no node is copied or allocated, it is O(1)
+   */
+  void splice(iterator pos, any_list &other, iterator first,
+              iterator last) noexcept {
+    if (first == last)
+      return;
+    node_base *back = last ? last._ptr->_prev : other._end;
+    other.unlink(first._ptr, back);
+    link_before(pos._ptr, first._ptr, back);
+  }
+  /// move every node of other before pos in O(1).
+  void splice(iterator pos, any_list &other) noexcept {
+    splice(pos, other, other.begin(), other.end());
+  }
+  /// remove the nodes of [first, last) and return them as a new list in O(1).
+  any_list take(iterator first, iterator last) noexcept {
+    any_list out;
+    out.splice(out.end(), *this, first, last);
+    return out;
+  }
+  any_list take(iterator first) noexcept { return take(first, end()); }
   std::reverse_iterator<iterator> rbegin() {
     return std::make_reverse_iterator(iterator(_end));
   }
   std::reverse_iterator<iterator> rend() {
     return std::make_reverse_iterator(iterator());
   }
-  const_iterator begin() const { return iterator(_begin.get()); }
+  const_iterator begin() const { return iterator(_begin); }
   const_iterator end() const { return iterator(); }
+  [[nodiscard]] bool empty() const noexcept { return !_begin; }
+  /**
+   * @brief call f on every element in order, as a reference on its type if
+   * it is one of Ts. the type is found with a single lookup in a table indexed
+   * by type_index instead of a chain of checks. other elements are passed as
+   * a node_base if f accepts it and skipped otherwise
+   */
+  template <typename... Ts, typename F> void visit_all(F &&f) {
+    static_assert(sizeof...(Ts) > 0, "visit_all needs the types to visit");
+    using visitor = std::remove_reference_t<F>;
+    const auto &table = visit_table<visitor, Ts...>();
+    for (node_base *ptr = _begin; ptr; ptr = ptr->_next) {
+      std::size_t index = ptr->index();
+      if (index < table.size() && table[index])
+        table[index](*ptr, f);
+      else if constexpr (std::is_invocable_v<visitor &, node_base &>)
+        f(*ptr);
+    }
+  }
+  /// free every node in a loop, nodes with a trivially destructible payload
+  /// are freed without an indirect call.
   void clear() noexcept {
-    _begin = null();
+    for (node_base *ptr = _begin; ptr;) {
+      node_base *next = ptr->_next;
+      node_base::destroy(ptr);
+      ptr = next;
+    }
+    _begin = nullptr;
     _end = nullptr;
+    _modifications++;
   }
+  ~any_list() { clear(); }
+};
+
+/**
+ * @brief per-type index of the elements of an any_list, it keeps for each
+ * type the nodes of that type in list order in a contiguous array. it is a
+ * snapshot holding pointers on the nodes: erasing, popping or unlinking an
+ * element leaves a dangling pointer in the index, which must be rebuilt or
+ * cleared before it is used again. in debug builds for_each and count assert
+ * that the list wasn't modified since the index was built, other than by
+ * adding the elements passed to add
+ */
+class any_list_index {
+  using node_base = any_list::node_base;
+  std::vector<std::vector<node_base *>> _by_type;
+  const any_list *_list = nullptr;
+  /// modifications of the list the index accounts for.
+  std::size_t _modifications = 0;
+
+  const std::vector<node_base *> *nodes_of(std::size_t index) const noexcept {
+    assert((!_list || _list->_modifications == _modifications) &&
+           "any_list modified since the index was built");
+    return index < _by_type.size() ? &_by_type[index] : nullptr;
+  }
+  void add(node_base *ptr) {
+    std::size_t index = ptr->index();
+    if (index >= _by_type.size())
+      _by_type.resize(index + 1);
+    _by_type[index].push_back(ptr);
+  }
+
+public:
+  any_list_index() = default;
+  explicit any_list_index(const any_list &list) { rebuild(list); }
+  /// index every element of list, in O(size of the list).
+  void rebuild(const any_list &list) {
+    for (auto &nodes : _by_type)
+      nodes.clear();
+    for (node_base *ptr = list._begin; ptr; ptr = ptr->_next)
+      add(ptr);
+    _list = &list;
+    _modifications = list._modifications;
+  }
+  /// index an element added to the list after the last rebuild, one call per
+  /// element inserted.
+  void add(any_list::iterator it) {
+    add(it._ptr);
+    _modifications++;
+  }
+  /// call f on every indexed element of type T, in O(count<T>()).
+  template <typename T, typename F> void for_each(F &&f) const {
+    if (auto *nodes = nodes_of(sg::type_index<T>()))
+      for (node_base *ptr : *nodes)
+        f(ptr->data<T>());
+  }
+  template <typename T> std::size_t count() const noexcept {
+    auto *nodes = nodes_of(sg::type_index<T>());
+    return nodes ? nodes->size() : 0;
+  }
+  void clear() noexcept {
+    _by_type.clear();
+    _list = nullptr;
+  }
+};
+
+/**
+ * @brief base of objects linked in an any_list without allocation, T is the
+ * derived type. the object is found by as<T> and get_if<T> like an emplaced
+ * element. copies of the object are not linked
+ */
+template <typename T> class any_list_hook : any_list::node_base {
+  friend class any_list;
+
+public:
+  any_list_hook() noexcept : node_base(std::in_place_type<T>, nullptr) {}
+  any_list_hook(const any_list_hook &) noexcept : any_list_hook() {}
+  any_list_hook &operator=(const any_list_hook &) noexcept { return *this; }
+  [[nodiscard]] bool is_linked() const noexcept { return _deleter; }
+  ~any_list_hook() { assert(!is_linked() && "destroyed while linked"); }
 };
 
 }; // namespace sg
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,208 @@
+/*
+ * type-erased single-pass range. the state of the source lives in an sbo and
+ * elements are pulled in batches so there is one indirect call per batch
+ */
+
+#ifndef UTILS_ANY_RANGE_HPP
+#define UTILS_ANY_RANGE_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <new>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+#include "sbo_base.hpp"
+#include "span.hpp"
+
+namespace sg {
+
+namespace detail {
+
+template <typename T> struct range_ops {
+  std::size_t (*next_batch)(void *, span<T>);
+  void (*destroy)(void *) noexcept;
+  void (*move)(void *, void *) noexcept;
+};
+
+template <typename T, typename S>
+std::size_t next_batch_func(void *source, span<T> out) {
+  return static_cast<S *>(source)->next_batch(out);
+}
+
+template <typename T, typename S>
+inline constexpr range_ops<T> range_ops_for{
+    &next_batch_func<T, S>, &destroy_func<S>, &move_func<S>};
+
+template <typename S, typename T, typename = void>
+struct is_range_source : std::false_type {};
+
+template <typename S, typename T>
+struct is_range_source<S, T,
+                       std::void_t<decltype(std::declval<S &>().next_batch(
+                           std::declval<span<T>>()))>> : std::true_type {};
+
+/// It is an input iterator whose elements can be assigned to a T.
+template <typename It, typename T, typename = void>
+struct is_input_iterator_of : std::false_type {};
+
+template <typename It, typename T>
+struct is_input_iterator_of<
+    It, T,
+    std::void_t<typename std::iterator_traits<It>::iterator_category,
+                decltype(std::declval<T &>() = *std::declval<It &>())>>
+    : std::is_base_of<std::input_iterator_tag,
+                      typename std::iterator_traits<It>::iterator_category> {
+};
+
+/// source reading [first, last), copied by blocks for random access
+/// iterators.
+template <typename It> struct iterator_source {
+  It first;
+  It last;
+  template <typename T> std::size_t next_batch(span<T> out) {
+    using category = typename std::iterator_traits<It>::iterator_category;
+    std::size_t count = 0;
+    if constexpr (std::is_base_of_v<std::random_access_iterator_tag,
+                                    category>) {
+      count = std::min<std::size_t>(out.size(), last - first);
+      std::copy_n(first, count, out.data());
+      first += count;
+    } else
+      for (; count < out.size() && first != last; ++first, ++count)
+        out[count] = *first;
+    return count;
+  }
+};
+
+/// source calling a generator returning std::optional until it is empty.
+template <typename G> struct generator_source {
+  G gen;
+  bool done = false;
+  template <typename T> std::size_t next_batch(span<T> out) {
+    std::size_t count = 0;
+    while (!done && count < out.size()) {
+      auto value = gen();
+      if (!value)
+        done = true;
+      else
+        out[count++] = std::move(*value);
+    }
+    return count;
+  }
+};
+
+} // namespace detail
+
+/**
+ * @brief move-only, type-erased source of T. any type with a
+ * next_batch(span<T>) member returning the number of elements written, 0 at
+ * the end, can be used as a source. iterator pairs and generators are wrapped
+ * in such a source. the range is single-pass: elements are consumed as they
+ * are pulled and can't be read again, so it only offers next_batch and
+ * for_each, not multi-pass iterators
+ * @tparam T type of the elements, they are copied in the buffer of the caller
+ * @tparam sbo_size size of the sbo holding the source
+ */
+template <typename T, std::size_t sbo_size = 32>
+class any_range : sbo_base<sbo_size> {
+  const detail::range_ops<T> *_ops = nullptr;
+
+  template <typename S> void setup(S &&source) {
+    using inplace_type = std::decay_t<S>;
+    static_assert(std::is_nothrow_move_constructible_v<inplace_type>);
+
+    if (!this->alloc(sizeof(inplace_type)))
+      throw std::bad_alloc();
+    new (this->ptr()) inplace_type(std::forward<S>(source));
+    _ops = &detail::range_ops_for<T, inplace_type>;
+  }
+  void destroy() noexcept {
+    if (_ops) {
+      _ops->destroy(this->ptr());
+      this->clear();
+      _ops = nullptr;
+    }
+  }
+  void move_from(any_range &other) noexcept {
+    if (!other._ops)
+      return;
+    if (other.is_sbo()) {
+      void *ptr = this->alloc(other.size());
+      other._ops->move(other.ptr(), ptr);
+      other._ops->destroy(other.ptr());
+      other.clear();
+    } else
+      this->steal(other);
+    _ops = std::exchange(other._ops, nullptr);
+  }
+
+public:
+  template <typename S>
+  constexpr static bool fit_sbo = sizeof(std::decay_t<S>) <= sbo_size;
+  constexpr static std::size_t buff_size = sbo_size;
+
+  any_range() noexcept = default;
+  template <typename S,
+            std::enable_if_t<!std::is_same_v<std::decay_t<S>, any_range> &&
+                                 detail::is_range_source<S, T>::value,
+                             int> = 0>
+  explicit any_range(S &&source) {
+    setup(std::forward<S>(source));
+  }
+  /// range over [first, last), the iterators are stored in the sbo. It must
+  /// be at least an input iterator.
+  template <typename It,
+            std::enable_if_t<detail::is_input_iterator_of<It, T>::value,
+                             int> = 0>
+  any_range(It first, It last) {
+    setup(detail::iterator_source<It>{std::move(first), std::move(last)});
+  }
+  /// range over the elements of r, it must outlive the any_range.
+  template <typename R> static any_range over(R &r) {
+    return any_range(std::begin(r), std::end(r));
+  }
+  /**
+   * @brief range over the values returned by gen until it returns an empty
+   * std::optional
+   */
+  template <typename G> static any_range from_generator(G &&gen) {
+    any_range range;
+    range.setup(detail::generator_source<std::decay_t<G>>{
+        std::forward<G>(gen)});
+    return range;
+  }
+  any_range(any_range &&other) noexcept { move_from(other); }
+  any_range &operator=(any_range &&other) noexcept {
+    if (this != &other) {
+      destroy();
+      move_from(other);
+    }
+    return *this;
+  }
+  any_range(const any_range &) = delete;
+  any_range &operator=(const any_range &) = delete;
+  /**
+   * @brief copy the next elements in out
+   * @return number of elements written, 0 once the range is exhausted
+   */
+  std::size_t next_batch(span<T> out) {
+    return _ops ? _ops->next_batch(this->ptr(), out) : 0;
+  }
+  /// call f on every remaining element, pulling batch_size elements at a
+  /// time into a buffer on the stack.
+  template <std::size_t batch_size = 64, typename F> void for_each(F &&f) {
+    T buffer[batch_size];
+    while (std::size_t count = next_batch(buffer))
+      for (std::size_t idx = 0; idx < count; idx++)
+        f(buffer[idx]);
+  }
+  [[nodiscard]] explicit operator bool() const noexcept { return _ops; }
+  ~any_range() { destroy(); }
+};
+
+} // namespace sg
+
+#endif // UTILS_ANY_RANGE_HPP
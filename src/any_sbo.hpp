@@ -0,0 +1,282 @@
+/*
+ * type similar to std::any but the size and alignment of the sbo and the
+ * allocator are configurable
+ */
+
+#ifndef UTILS_ANY_SBO_HPP
+#define UTILS_ANY_SBO_HPP
+
+#include <any>
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "sbo_base.hpp"
+#include "type_id.hpp"
+
+namespace sg {
+
+namespace detail {
+
+template <typename T> void copy_func(const void *from, void *to) {
+  new (to) T(*static_cast<const T *>(from));
+}
+
+/**
+ * @brief operations shared by all any_sbo storing the same type. entries that
+ * are trivial for the type are nullptr so that the caller uses memcpy or does
+ * nothing instead of an indirect call
+ */
+struct any_ops {
+  void (*destroy)(void *) noexcept;
+  void (*move)(void *, void *) noexcept;
+  void (*copy)(const void *, void *);
+  type_id_t type;
+  template <typename T> static constexpr any_ops make() {
+    constexpr bool is_trivial = std::is_trivially_copyable_v<T>;
+    return {std::is_trivially_destructible_v<T> ? nullptr : &destroy_func<T>,
+            is_trivial ? nullptr : &move_func<T>,
+            is_trivial ? nullptr : &copy_func<T>, type_id<T>()};
+  }
+};
+
+template <typename> struct is_in_place_type : std::false_type {};
+
+template <typename T>
+struct is_in_place_type<std::in_place_type_t<T>> : std::true_type {};
+
+/// one table per type, its address identifies the stored type.
+template <typename T>
+inline constexpr any_ops any_ops_for = any_ops::make<T>();
+
+} // namespace detail
+
+/**
+ * @brief copyable container for a single value of any copyable type. values
+ * that fit in the sbo are stored inline, other values are allocated with
+ * Allocator
+ * @tparam sbo_size size of the sbo
+ * @tparam sbo_align alignment of the sbo
+ * @tparam Allocator allocator used for values that don't fit in the sbo,
+ * values are moved between any_sbo by stealing the pointer so it must be
+ * stateless
+ */
+template <std::size_t sbo_size = 32,
+          std::size_t sbo_align = alignof(std::max_align_t),
+          typename Allocator = malloc_allocator>
+class any_sbo : sbo_base<sbo_size, sbo_align, Allocator> {
+  const detail::any_ops *_ops = nullptr;
+
+  template <typename T>
+  static constexpr const detail::any_ops *ops_for() noexcept {
+    return &detail::any_ops_for<T>;
+  }
+  template <typename T> static constexpr void check() {
+    static_assert(std::is_copy_constructible_v<T>,
+                  "any_sbo requires copyable types");
+    static_assert(std::is_nothrow_move_constructible_v<T>,
+                  "moves of any_sbo can't throw");
+    static_assert(alignof(T) <= (sizeof(T) <= sbo_size
+                                     ? sbo_align
+                                     : alignof(std::max_align_t)),
+                  "alignment of the type is too large");
+  }
+  void move_from(any_sbo &other) noexcept {
+    if (!other._ops)
+      return;
+    if (other.is_sbo()) {
+      void *to = this->alloc(other.size());
+      if (other._ops->move) {
+        other._ops->move(other.ptr(), to);
+        if (other._ops->destroy)
+          other._ops->destroy(other.ptr());
+      } else
+        std::memcpy(to, other.ptr(), other.size());
+      other.clear();
+    } else
+      this->steal(other);
+    _ops = std::exchange(other._ops, nullptr);
+  }
+  void copy_from(const any_sbo &other) {
+    if (!other._ops)
+      return;
+    void *to = this->alloc(other.size());
+    if (!to)
+      throw std::bad_alloc();
+    if (other._ops->copy) {
+      try {
+        other._ops->copy(other.ptr(), to);
+      } catch (...) {
+        this->clear();
+        throw;
+      }
+    } else
+      std::memcpy(to, other.ptr(), other.size());
+    _ops = other._ops;
+  }
+
+public:
+  template <typename T>
+  constexpr static bool fit_sbo =
+      sizeof(std::decay_t<T>) <= sbo_size &&
+      alignof(std::decay_t<T>) <= sbo_align;
+  constexpr static std::size_t buff_size = sbo_size;
+
+  any_sbo() noexcept = default;
+  any_sbo(const any_sbo &other) { copy_from(other); }
+  any_sbo(any_sbo &&other) noexcept { move_from(other); }
+  template <typename T,
+            std::enable_if_t<
+                !std::is_same_v<std::decay_t<T>, any_sbo> &&
+                    !detail::is_in_place_type<std::decay_t<T>>::value &&
+                    std::is_copy_constructible_v<std::decay_t<T>>,
+                int> = 0>
+  any_sbo(T &&value) {
+    emplace<std::decay_t<T>>(std::forward<T>(value));
+  }
+  template <typename T, typename... Ts>
+  explicit any_sbo(std::in_place_type_t<T>, Ts &&... ts) {
+    emplace<T>(std::forward<Ts>(ts)...);
+  }
+  any_sbo &operator=(const any_sbo &other) {
+    if (this != &other)
+      *this = any_sbo(other);
+    return *this;
+  }
+  any_sbo &operator=(any_sbo &&other) noexcept {
+    if (this != &other) {
+      reset();
+      move_from(other);
+    }
+    return *this;
+  }
+  template <typename T,
+            std::enable_if_t<!std::is_same_v<std::decay_t<T>, any_sbo> &&
+                                 std::is_copy_constructible_v<std::decay_t<T>>,
+                             int> = 0>
+  any_sbo &operator=(T &&value) {
+    using value_type = std::decay_t<T>;
+    // value may refer to the current value so the new one is built first.
+    // if it fits in the current storage the nothrow move into it keeps the
+    // heap block, otherwise it is built in a temporary that is moved in
+    if (sizeof(value_type) <= this->capacity()) {
+      value_type tmp(std::forward<T>(value));
+      emplace<value_type>(std::move(tmp));
+    } else
+      *this = any_sbo(std::in_place_type<value_type>, std::forward<T>(value));
+    return *this;
+  }
+  /**
+   * @brief destroy the current value and construct a T in place from ts
+   * @return reference on the new value
+   */
+  template <typename T, typename... Ts> std::decay_t<T> &emplace(Ts &&... ts) {
+    using value_type = std::decay_t<T>;
+    check<value_type>();
+    reset();
+    void *ptr = this->alloc(sizeof(value_type));
+    if (!ptr)
+      throw std::bad_alloc();
+    value_type *value;
+    try {
+      value = new (ptr) value_type(std::forward<Ts>(ts)...);
+    } catch (...) {
+      this->clear();
+      throw;
+    }
+    _ops = ops_for<value_type>();
+    return *value;
+  }
+  void reset() noexcept {
+    if (_ops) {
+      if (_ops->destroy)
+        _ops->destroy(this->ptr());
+      this->clear();
+      _ops = nullptr;
+    }
+  }
+  /// release the heap block kept after the value was destroyed, or move a
+  /// heap value to a block of its size.
+  void shrink_to_fit() noexcept {
+    sbo_base<sbo_size, sbo_align, Allocator>::shrink_to_fit(
+        [this](void *from, void *to) {
+          if (_ops->move) {
+            _ops->move(from, to);
+            if (_ops->destroy)
+              _ops->destroy(from);
+          } else
+            std::memcpy(to, from, this->size());
+        });
+  }
+  void swap(any_sbo &other) noexcept {
+    any_sbo tmp(std::move(other));
+    other = std::move(*this);
+    *this = std::move(tmp);
+  }
+  [[nodiscard]] bool has_value() const noexcept { return _ops; }
+  /// type_id of the value or type_id<void>() if empty.
+  [[nodiscard]] type_id_t type() const noexcept {
+    return _ops ? _ops->type : type_id<void>();
+  }
+  /**
+   * @brief return a pointer on the value if it is a T, nullptr otherwise. the
+   * check is a single compare against the operations of T
+   */
+  template <typename T> [[nodiscard]] T *target() noexcept {
+    if (_ops == ops_for<std::remove_cv_t<T>>())
+      return static_cast<T *>(this->ptr());
+    return nullptr;
+  }
+  template <typename T> [[nodiscard]] const T *target() const noexcept {
+    if (_ops == ops_for<std::remove_cv_t<T>>())
+      return static_cast<const T *>(this->ptr());
+    return nullptr;
+  }
+  ~any_sbo() { reset(); }
+};
+
+/// like std::any_cast, return nullptr if a is null or doesn't hold a T.
+template <typename T, std::size_t N, std::size_t A, typename Al>
+[[nodiscard]] T *any_cast(any_sbo<N, A, Al> *a) noexcept {
+  return a ? a->template target<T>() : nullptr;
+}
+
+template <typename T, std::size_t N, std::size_t A, typename Al>
+[[nodiscard]] const T *any_cast(const any_sbo<N, A, Al> *a) noexcept {
+  return a ? a->template target<T>() : nullptr;
+}
+
+/// like std::any_cast, throw std::bad_any_cast if a doesn't hold a T.
+template <typename T, std::size_t N, std::size_t A, typename Al>
+T any_cast(any_sbo<N, A, Al> &a) {
+  using value_type = std::remove_cv_t<std::remove_reference_t<T>>;
+  auto *ptr = a.template target<value_type>();
+  if (!ptr)
+    throw std::bad_any_cast();
+  return static_cast<T>(*ptr);
+}
+
+template <typename T, std::size_t N, std::size_t A, typename Al>
+T any_cast(const any_sbo<N, A, Al> &a) {
+  using value_type = std::remove_cv_t<std::remove_reference_t<T>>;
+  auto *ptr = a.template target<value_type>();
+  if (!ptr)
+    throw std::bad_any_cast();
+  return static_cast<T>(*ptr);
+}
+
+template <typename T, std::size_t N, std::size_t A, typename Al>
+T any_cast(any_sbo<N, A, Al> &&a) {
+  using value_type = std::remove_cv_t<std::remove_reference_t<T>>;
+  auto *ptr = a.template target<value_type>();
+  if (!ptr)
+    throw std::bad_any_cast();
+  return static_cast<T>(std::move(*ptr));
+}
+
+} // namespace sg
+
+#endif // UTILS_ANY_SBO_HPP
@@ -0,0 +1,238 @@
+/*
+ * type-erased sequence whose elements are stored one after the other in a
+ * single growable buffer, each behind a small header, so a traversal reads
+ * memory linearly instead of chasing node pointers
+ */
+
+#ifndef UTILS_ANY_VECTOR_HPP
+#define UTILS_ANY_VECTOR_HPP
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "sbo_base.hpp"
+#include "type_id.hpp"
+
+namespace sg {
+
+namespace detail {
+
+/// operations of the elements of a type, entries are nullptr when the
+/// operation is trivial.
+struct vector_entry_ops {
+  void (*destroy)(void *) noexcept;
+  /// move construct at the second pointer and destroy the first.
+  void (*relocate)(void *, void *) noexcept;
+  type_id_t type;
+};
+
+template <typename T> void relocate_func(void *from, void *to) noexcept {
+  new (to) T(std::move(*static_cast<T *>(from)));
+  static_cast<T *>(from)->~T();
+}
+
+/// one table per type, its address identifies the type of an element.
+template <typename T>
+inline constexpr vector_entry_ops vector_entry_ops_for{
+    std::is_trivially_destructible_v<T> ? nullptr : &destroy_func<T>,
+    std::is_trivially_copyable_v<T> ? nullptr : &relocate_func<T>,
+    type_id<T>()};
+
+} // namespace detail
+
+/**
+ * @brief sequence of values of any nothrow movable type. an element is a
+ * header holding its operations and its size followed by the value, elements
+ * are relocated when the buffer grows. appending is amortized O(1)
+ */
+class any_vector {
+  static constexpr std::size_t align = alignof(std::max_align_t);
+
+  struct alignas(align) header {
+    const detail::vector_entry_ops *ops;
+    /// bytes from this header to the next one.
+    std::size_t stride;
+  };
+
+  std::byte *_data = nullptr;
+  std::size_t _bytes = 0;
+  std::size_t _capacity = 0;
+  std::size_t _count = 0;
+
+  static constexpr std::size_t stride_of(std::size_t size) noexcept {
+    return sizeof(header) + (size + align - 1) / align * align;
+  }
+  void grow(std::size_t min_capacity) {
+    std::size_t capacity = std::max(min_capacity, _capacity * 2);
+    auto *data = static_cast<std::byte *>(std::malloc(capacity));
+    if (!data)
+      throw std::bad_alloc();
+    for (std::size_t offset = 0; offset < _bytes;) {
+      auto *from = reinterpret_cast<header *>(_data + offset);
+      auto *to = new (data + offset) header(*from);
+      if (from->ops->relocate)
+        from->ops->relocate(from + 1, to + 1);
+      else
+        std::memcpy(to + 1, from + 1, from->stride - sizeof(header));
+      offset += from->stride;
+    }
+    std::free(_data);
+    _data = data;
+    _capacity = capacity;
+  }
+
+public:
+  /// view on an element.
+  class entry {
+    header *_header;
+    explicit entry(header *h) noexcept : _header{h} {}
+    friend class any_vector;
+
+  public:
+    [[nodiscard]] type_id_t type() const noexcept {
+      return _header->ops->type;
+    }
+    /// single compare against the operations of T.
+    template <typename T> [[nodiscard]] bool is() const noexcept {
+      return _header->ops == &detail::vector_entry_ops_for<T>;
+    }
+    void *data() const noexcept { return _header + 1; }
+    template <typename T> T &as() const noexcept {
+      assert(is<T>() && "bad type");
+      return *std::launder(static_cast<T *>(data()));
+    }
+    template <typename T> T *get_if() const noexcept {
+      return is<T>() ? &as<T>() : nullptr;
+    }
+  };
+
+  class iterator {
+    std::byte *_ptr = nullptr;
+    explicit iterator(std::byte *ptr) noexcept : _ptr{ptr} {}
+    friend class any_vector;
+
+  public:
+    using value_type = entry;
+    using reference = entry;
+    using difference_type = std::ptrdiff_t;
+    using iterator_category = std::input_iterator_tag;
+
+    iterator() noexcept = default;
+    entry operator*() const noexcept {
+      return entry(reinterpret_cast<header *>(_ptr));
+    }
+    iterator &operator++() noexcept {
+      _ptr += reinterpret_cast<header *>(_ptr)->stride;
+      return *this;
+    }
+    iterator operator++(int) noexcept {
+      iterator tmp = *this;
+      ++*this;
+      return tmp;
+    }
+    bool operator==(iterator other) const noexcept {
+      return _ptr == other._ptr;
+    }
+    bool operator!=(iterator other) const noexcept {
+      return _ptr != other._ptr;
+    }
+  };
+
+  any_vector() noexcept = default;
+  any_vector(any_vector &&other) noexcept
+      : _data{std::exchange(other._data, nullptr)},
+        _bytes{std::exchange(other._bytes, 0)},
+        _capacity{std::exchange(other._capacity, 0)},
+        _count{std::exchange(other._count, 0)} {}
+  any_vector &operator=(any_vector &&other) noexcept {
+    if (this != &other) {
+      this->~any_vector();
+      new (this) any_vector(std::move(other));
+    }
+    return *this;
+  }
+  any_vector(const any_vector &) = delete;
+  any_vector &operator=(const any_vector &) = delete;
+
+  /**
+   * @brief construct a T from ts at the end
+   * @return reference on the new element, it is invalidated when the buffer
+   * grows
+   */
+  template <typename T, typename... Ts> T &emplace_back(Ts &&... ts) {
+    static_assert(std::is_nothrow_move_constructible_v<T>,
+                  "elements are relocated when the buffer grows");
+    static_assert(alignof(T) <= align, "alignment of the type is too large");
+    constexpr std::size_t stride = stride_of(sizeof(T));
+    if (_capacity - _bytes < stride)
+      grow(_bytes + stride);
+    auto *h = new (_data + _bytes) header{&detail::vector_entry_ops_for<T>,
+                                          stride};
+    T *value = new (h + 1) T(std::forward<Ts>(ts)...);
+    _bytes += stride;
+    _count++;
+    return *value;
+  }
+  template <typename T> std::decay_t<T> &push_back(T &&value) {
+    return emplace_back<std::decay_t<T>>(std::forward<T>(value));
+  }
+  /// reserve room for bytes of headers and values.
+  void reserve(std::size_t bytes) {
+    if (bytes > _capacity)
+      grow(bytes);
+  }
+  /// number of bytes used by an element of type T.
+  template <typename T> static constexpr std::size_t entry_size() noexcept {
+    return stride_of(sizeof(T));
+  }
+  /// call f on every element of type T, in order.
+  template <typename T, typename F> void for_each_of(F &&f) {
+    for (entry e : *this)
+      if (e.is<T>())
+        f(e.as<T>());
+  }
+  /**
+   * @brief call f with every element whose type is one of Ts, as a reference
+   * on that type. other elements are passed as an entry if f accepts it and
+   * skipped otherwise
+   */
+  template <typename... Ts, typename F> void visit(F &&f) {
+    for (entry e : *this) {
+      bool found = ((e.is<Ts>() ? (f(e.as<Ts>()), true) : false) || ...);
+      if constexpr (std::is_invocable_v<F &, entry>)
+        if (!found)
+          f(e);
+    }
+  }
+  /// destroy every element, the buffer is kept.
+  void clear() noexcept {
+    for (entry e : *this)
+      if (e._header->ops->destroy)
+        e._header->ops->destroy(e.data());
+    _bytes = 0;
+    _count = 0;
+  }
+  iterator begin() const noexcept { return iterator(_data); }
+  iterator end() const noexcept { return iterator(_data + _bytes); }
+  std::size_t size() const noexcept { return _count; }
+  [[nodiscard]] bool empty() const noexcept { return _count == 0; }
+  /// bytes used by the headers and the values.
+  std::size_t bytes() const noexcept { return _bytes; }
+  std::size_t capacity() const noexcept { return _capacity; }
+  ~any_vector() {
+    clear();
+    std::free(_data);
+  }
+};
+
+} // namespace sg
+
+#endif // UTILS_ANY_VECTOR_HPP
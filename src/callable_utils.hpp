@@ -37,9 +37,8 @@ struct is_instance_of<M<T, N...>, M> : std::true_type {};
 
 template <typename, typename> struct is_same_sig : std::false_type {};
 
-template <template <typename, auto...> class C, typename Sig, auto N, auto M,
-          bool E>
-struct is_same_sig<C<Sig, N, E>, C<Sig, M, E>> : std::true_type {};
+template <template <typename, auto...> class C, typename Sig, auto N, auto M>
+struct is_same_sig<C<Sig, N>, C<Sig, M>> : std::true_type {};
 
 /**
  * @brief similar to std::forward but adapted to a context where the real type
@@ -60,6 +59,14 @@ T &propagate(T &&t) {
   return t;
 }
 
+/// callable whose overloads are the call operators of Fs, to build a
+/// visitor from lambdas.
+template <typename... Fs> struct overloaded : Fs... {
+  using Fs::operator()...;
+};
+
+template <typename... Fs> overloaded(Fs...) -> overloaded<Fs...>;
+
 } // namespace sg
 
 #endif // UTILS_INVOKABLE_TRAITS_HPP
@@ -0,0 +1,272 @@
+/*
+ * container of type-erased callables sharing a signature. callables are
+ * grouped by type and each group is stored contiguously, so invoking all of
+ * them costs one indirect call per type instead of one per element
+ */
+
+#ifndef UTILS_CALLABLE_VECTOR_HPP
+#define UTILS_CALLABLE_VECTOR_HPP
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "callable_utils.hpp"
+#include "type_id.hpp"
+
+namespace sg {
+
+template <typename> class callable_vector {};
+
+template <typename R, typename... Args> class callable_vector<R(Args...)> {
+public:
+  /// stable reference on an element, it stays valid until the element is
+  /// erased even if other elements are inserted or erased.
+  class handle {
+    std::uint32_t _index = UINT32_MAX;
+    std::uint32_t _generation = 0;
+    handle(std::uint32_t index, std::uint32_t generation)
+        : _index{index}, _generation{generation} {}
+
+  public:
+    handle() noexcept = default;
+    bool operator==(handle other) const noexcept {
+      return _index == other._index && _generation == other._generation;
+    }
+    bool operator!=(handle other) const noexcept { return !(*this == other); }
+    friend class callable_vector;
+  };
+
+private:
+  /// operations of a group, the invoke entry loops over the whole group and
+  /// calls each element directly.
+  struct group_ops {
+    R *(*invoke_all)(std::byte *, std::size_t, R *,
+                     std::add_lvalue_reference_t<Args>...);
+    void (*relocate)(void *, void *) noexcept;
+    void (*destroy)(void *) noexcept;
+    std::size_t size;
+    std::size_t align;
+    type_id_t type;
+  };
+  /// the results are stored from out if it isn't nullptr, return the end
+  /// of the results.
+  template <typename T>
+  static R *invoke_all_func(std::byte *data, std::size_t count, R *out,
+                            std::add_lvalue_reference_t<Args>... args) {
+    T *first = std::launder(reinterpret_cast<T *>(data));
+    if constexpr (!std::is_void_v<R>)
+      if (out) {
+        for (T *it = first; it != first + count; ++it)
+          *out++ = (*it)(args...);
+        return out;
+      }
+    for (T *it = first; it != first + count; ++it)
+      (*it)(args...);
+    return out;
+  }
+  template <typename T>
+  static void relocate_func(void *from, void *to) noexcept {
+    new (to) T(std::move(*static_cast<T *>(from)));
+    static_cast<T *>(from)->~T();
+  }
+  template <typename T> static void destroy_func(void *data) noexcept {
+    static_cast<T *>(data)->~T();
+  }
+  template <typename T>
+  static constexpr group_ops ops_for{&invoke_all_func<T>, &relocate_func<T>,
+                                     &destroy_func<T>,    sizeof(T),
+                                     alignof(T),          type_id<T>()};
+  struct group {
+    const group_ops *ops;
+    std::byte *data = nullptr;
+    std::size_t size = 0;
+    std::size_t capacity = 0;
+    /// handle index of each element
+    std::vector<std::uint32_t> owners;
+    void *at(std::size_t pos) const noexcept {
+      return data + pos * ops->size;
+    }
+  };
+  /// slot in the group of the element, or the next free entry if unused.
+  struct handle_entry {
+    std::uint32_t group;
+    std::uint32_t slot;
+    std::uint32_t generation;
+  };
+  static constexpr std::uint32_t npos = UINT32_MAX;
+  std::vector<group> _groups;
+  std::vector<handle_entry> _handles;
+  std::uint32_t _free_handle = npos;
+  std::size_t _size = 0;
+
+  std::uint32_t find_group(const group_ops *ops) {
+    for (std::uint32_t idx = 0; idx < _groups.size(); idx++)
+      if (_groups[idx].ops == ops)
+        return idx;
+    _groups.push_back(group{ops, nullptr, 0, 0, {}});
+    return _groups.size() - 1;
+  }
+  static void grow(group &g) {
+    std::size_t capacity = g.capacity ? g.capacity * 2 : 4;
+    std::byte *data = static_cast<std::byte *>(::operator new(
+        capacity * g.ops->size, std::align_val_t(g.ops->align)));
+    for (std::size_t pos = 0; pos < g.size; pos++)
+      g.ops->relocate(g.at(pos), data + pos * g.ops->size);
+    release(g);
+    g.data = data;
+    g.capacity = capacity;
+  }
+  static void release(group &g) noexcept {
+    if (g.data)
+      ::operator delete(g.data, std::align_val_t(g.ops->align));
+  }
+  std::uint32_t alloc_handle(std::uint32_t group,
+                             std::uint32_t slot) noexcept {
+    if (_free_handle == npos) {
+      _handles.push_back({group, slot, 0});
+      return _handles.size() - 1;
+    }
+    std::uint32_t idx = _free_handle;
+    _free_handle = _handles[idx].slot;
+    _handles[idx].group = group;
+    _handles[idx].slot = slot;
+    return idx;
+  }
+  void free_handle(std::uint32_t idx) noexcept {
+    _handles[idx].generation++;
+    _handles[idx].group = npos;
+    _handles[idx].slot = _free_handle;
+    _free_handle = idx;
+  }
+
+public:
+  callable_vector() noexcept = default;
+  callable_vector(const callable_vector &) = delete;
+  callable_vector &operator=(const callable_vector &) = delete;
+  callable_vector(callable_vector &&other) noexcept
+      : _groups{std::move(other._groups)},
+        _handles{std::move(other._handles)},
+        _free_handle{other._free_handle}, _size{other._size} {
+    other._groups.clear();
+    other._handles.clear();
+    other._free_handle = npos;
+    other._size = 0;
+  }
+  callable_vector &operator=(callable_vector &&other) noexcept {
+    if (this != &other) {
+      this->~callable_vector();
+      new (this) callable_vector(std::move(other));
+    }
+    return *this;
+  }
+  /**
+   * @brief construct a T in place in the group of T
+   * @return handle that can be used to erase the element
+   */
+  template <typename T, typename... Ts> handle emplace(Ts &&... ts) {
+    static_assert(std::is_same_v<T, std::decay_t<T>>);
+    static_assert(std::is_nothrow_move_constructible_v<T>,
+                  "elements are relocated when a group grows");
+    static_assert(std::is_invocable_r_v<R, T &, Args &...>,
+                  "callable must be invocable with lvalues of the arguments");
+    (void)sig_asserts<T, R(Args...)>{};
+    std::uint32_t group_idx = find_group(&ops_for<T>);
+    group &g = _groups[group_idx];
+    if (g.size == g.capacity)
+      grow(g);
+    g.owners.reserve(g.capacity);
+    if (_free_handle == npos)
+      _handles.reserve(_handles.size() + 1);
+    new (g.at(g.size)) T(std::forward<Ts>(ts)...);
+    std::uint32_t idx = alloc_handle(group_idx, g.size);
+    g.owners.push_back(idx);
+    g.size++;
+    _size++;
+    return handle{idx, _handles[idx].generation};
+  }
+  template <typename F> handle insert(F &&f) {
+    return emplace<std::decay_t<F>>(std::forward<F>(f));
+  }
+  [[nodiscard]] bool contains(handle h) const noexcept {
+    return h._index < _handles.size() &&
+           _handles[h._index].generation == h._generation &&
+           _handles[h._index].group != npos;
+  }
+  /**
+   * @brief destroy the element referenced by h, the last element of its group
+   * is moved in its place
+   */
+  void erase(handle h) noexcept {
+    assert(contains(h) && "invalid handle");
+    handle_entry &entry = _handles[h._index];
+    group &g = _groups[entry.group];
+    std::size_t last = g.size - 1;
+    g.ops->destroy(g.at(entry.slot));
+    if (entry.slot != last) {
+      g.ops->relocate(g.at(last), g.at(entry.slot));
+      g.owners[entry.slot] = g.owners[last];
+      _handles[g.owners[entry.slot]].slot = entry.slot;
+    }
+    g.owners.pop_back();
+    g.size--;
+    _size--;
+    free_handle(h._index);
+  }
+  /**
+   * @brief call every element with args, elements are called group by group
+   * so the order of calls is unspecified. arguments are passed as lvalues
+   * since they are shared between calls, results are discarded
+   */
+  void invoke_all(Args... args) {
+    for (group &g : _groups)
+      if (g.size)
+        g.ops->invoke_all(g.data, g.size, nullptr, args...);
+  }
+  /**
+   * @brief like invoke_all but the results are assigned to out, which must
+   * have room for size() of them. they follow the group by group order of
+   * the calls, nothing is allocated
+   * @return the end of the results
+   */
+  R *invoke_all(R *out, Args... args) {
+    static_assert(!std::is_void_v<R>, "calls don't return results");
+    for (group &g : _groups)
+      if (g.size)
+        out = g.ops->invoke_all(g.data, g.size, out, args...);
+    return out;
+  }
+  /// number of distinct types stored.
+  [[nodiscard]] std::size_t group_count() const noexcept {
+    std::size_t count = 0;
+    for (const group &g : _groups)
+      count += g.size != 0;
+    return count;
+  }
+  [[nodiscard]] std::size_t size() const noexcept { return _size; }
+  [[nodiscard]] bool empty() const noexcept { return _size == 0; }
+  void clear() noexcept {
+    for (group &g : _groups) {
+      for (std::size_t pos = 0; pos < g.size; pos++) {
+        g.ops->destroy(g.at(pos));
+        free_handle(g.owners[pos]);
+      }
+      g.owners.clear();
+      g.size = 0;
+    }
+    _size = 0;
+  }
+  ~callable_vector() {
+    clear();
+    for (group &g : _groups)
+      release(g);
+  }
+};
+
+} // namespace sg
+
+#endif // UTILS_CALLABLE_VECTOR_HPP
@@ -0,0 +1,187 @@
+/*
+ * fixed capacity buffer that many threads can append to without a lock.
+ * slots are reserved with a fetch_add and published once constructed, so
+ * readers only ever see fully built elements
+ */
+
+#ifndef UTILS_CONCURRENT_FIXED_BUFFER_HPP
+#define UTILS_CONCURRENT_FIXED_BUFFER_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#include "fixed_buffer.hpp"
+#include "span.hpp"
+
+namespace utils {
+
+/**
+ * @brief append-only buffer of at most capacity elements. appends are
+ * lock-free and never move elements, so T can be non-movable
+ * @tparam T type of the elements
+ * @tparam Allocator same requirements as for fixed_buffer
+ */
+template <typename T, typename Allocator = aligned_allocator>
+class concurrent_fixed_buffer : private Allocator {
+public:
+  using value_type = T;
+  using size_type = std::size_t;
+  using reference = value_type &;
+  using const_reference = const value_type &;
+
+private:
+  enum slot_state : std::uint8_t { empty, ready, failed };
+
+  T *_data = nullptr;
+  std::unique_ptr<std::atomic<std::uint8_t>[]> _states;
+  size_type _capacity = 0;
+  /// number of slots handed out, it may go past the capacity.
+  std::atomic<size_type> _reserved{0};
+
+  /// reserve up to count slots and return the first one and the number
+  /// obtained, 0 if the buffer is full.
+  std::pair<size_type, size_type> reserve(size_type count) noexcept {
+    if (_reserved.load(std::memory_order_relaxed) >= _capacity)
+      return {_capacity, 0};
+    size_type first = _reserved.fetch_add(count, std::memory_order_relaxed);
+    if (first >= _capacity)
+      return {_capacity, 0};
+    return {first, std::min(count, _capacity - first)};
+  }
+  void publish(size_type pos, slot_state state) noexcept {
+    _states[pos].store(state, std::memory_order_release);
+  }
+  /// construct the element at pos with make(ptr) and publish it.
+  template <typename Make> T *create_at(size_type pos, Make &&make) {
+    T *ptr;
+    try {
+      ptr = make(static_cast<void *>(_data + pos));
+    } catch (...) {
+      publish(pos, failed);
+      throw;
+    }
+    publish(pos, ready);
+    return ptr;
+  }
+  std::string full_msg() const {
+    return "concurrent_fixed_buffer is full : capacity " +
+           std::to_string(_capacity);
+  }
+
+public:
+  concurrent_fixed_buffer() noexcept = default;
+  explicit concurrent_fixed_buffer(size_type capacity,
+                                   const Allocator &alloc = Allocator())
+      : Allocator(alloc) {
+    if (capacity > fixed_buffer<T>::max_size())
+      throw std::length_error("concurrent_fixed_buffer size too large : " +
+                              std::to_string(capacity));
+    if (capacity == 0)
+      return;
+    _states.reset(new std::atomic<std::uint8_t>[capacity]);
+    for (size_type pos = 0; pos < capacity; pos++)
+      _states[pos].store(empty, std::memory_order_relaxed);
+    _data = static_cast<T *>(
+        this->allocate(sizeof(T) * capacity, alignof(T)));
+    if (!_data)
+      throw std::bad_alloc();
+    _capacity = capacity;
+  }
+  concurrent_fixed_buffer(const concurrent_fixed_buffer &) = delete;
+  concurrent_fixed_buffer &operator=(const concurrent_fixed_buffer &) = delete;
+  /**
+   * @brief construct an element from ts in the next free slot, thread-safe
+   * @return pointer on the element or nullptr if the buffer is full
+   */
+  template <typename... Ts> T *try_emplace(Ts &&... ts) {
+    auto [pos, count] = reserve(1);
+    if (!count)
+      return nullptr;
+    return create_at(pos, [&](void *ptr) {
+      return new (ptr) T(std::forward<Ts>(ts)...);
+    });
+  }
+  /// like try_emplace but throws std::length_error if the buffer is full.
+  template <typename... Ts> reference emplace(Ts &&... ts) {
+    if (T *ptr = try_emplace(std::forward<Ts>(ts)...))
+      return *ptr;
+    throw std::length_error(full_msg());
+  }
+  /**
+   * @brief reserve count consecutive slots with a single atomic operation and
+   * construct element i from f(i), each element is published once built.
+   * fewer elements are built if the buffer doesn't have room for count. if f
+   * or a constructor throws, the remaining slots of the chunk stay unused
+   * @return the elements built
+   */
+  template <typename F> sg::span<T> emplace_n(size_type count, F &&f) {
+    auto [first, reserved] = reserve(count);
+    size_type idx = 0;
+    try {
+      for (; idx < reserved; idx++)
+        create_at(first + idx,
+                  [&](void *ptr) { return new (ptr) T(f(idx)); });
+    } catch (...) {
+      for (idx++; idx < reserved; idx++)
+        publish(first + idx, failed);
+      throw;
+    }
+    return {_data + first, reserved};
+  }
+  /// element at pos if it is published, nullptr otherwise. thread-safe.
+  T *get(size_type pos) noexcept {
+    if (pos < _capacity &&
+        _states[pos].load(std::memory_order_acquire) == ready)
+      return _data + pos;
+    return nullptr;
+  }
+  const T *get(size_type pos) const noexcept {
+    return const_cast<concurrent_fixed_buffer *>(this)->get(pos);
+  }
+  /// call f on every published element, in slot order. thread-safe, elements
+  /// published during the call may be skipped.
+  template <typename F> void for_each(F &&f) {
+    for (size_type pos = 0, last = size(); pos < last; pos++)
+      if (T *ptr = get(pos))
+        f(*ptr);
+  }
+  /// element at pos, it must be published.
+  reference operator[](size_type pos) noexcept { return _data[pos]; }
+  const_reference operator[](size_type pos) const noexcept {
+    return _data[pos];
+  }
+  /// number of slots reserved, including slots still being built and slots
+  /// whose construction failed.
+  size_type size() const noexcept {
+    return std::min(_reserved.load(std::memory_order_acquire), _capacity);
+  }
+  size_type capacity() const noexcept { return _capacity; }
+  [[nodiscard]] bool full() const noexcept { return size() == _capacity; }
+  /// destroy every element, it must not run concurrently with other calls.
+  void clear() noexcept {
+    for (size_type pos = 0, last = size(); pos < last; pos++) {
+      if (_states[pos].load(std::memory_order_relaxed) == ready)
+        _data[pos].~T();
+      _states[pos].store(empty, std::memory_order_relaxed);
+    }
+    _reserved.store(0, std::memory_order_relaxed);
+  }
+  ~concurrent_fixed_buffer() {
+    if (_data) {
+      clear();
+      this->deallocate(_data, sizeof(T) * _capacity, alignof(T));
+    }
+  }
+};
+
+} // namespace utils
+
+#endif // UTILS_CONCURRENT_FIXED_BUFFER_HPP
@@ -6,19 +6,206 @@
 #ifndef MT_TESTS_FIXED_BUFF_HPP
 #define MT_TESTS_FIXED_BUFF_HPP
 
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
 #include <cstdlib>
 #include <cstring>
+#include <exception>
 #include <memory>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <thread>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
 namespace utils {
 
+/**
+ * @brief default allocator of fixed_buffer, malloc unless the alignment is
+ * larger than the one malloc guarantees. over-aligned blocks are taken from a
+ * larger malloc block whose address is stored just before the aligned one,
+ * so that they can come from calloc too
+ */
+struct aligned_allocator {
+  void *allocate(std::size_t size, std::size_t align) noexcept {
+    if (align <= alignof(std::max_align_t))
+      return std::malloc(size);
+    return size + align < size
+               ? nullptr
+               : align_block(std::malloc(size + align), align);
+  }
+  /// calloc leaves fresh pages of large blocks untouched instead of clearing
+  /// them.
+  void *allocate_zeroed(std::size_t size, std::size_t align) noexcept {
+    if (align <= alignof(std::max_align_t))
+      return std::calloc(1, size);
+    return size + align < size
+               ? nullptr
+               : align_block(std::calloc(1, size + align), align);
+  }
+  void deallocate(void *ptr, std::size_t, std::size_t align) noexcept {
+    if (align <= alignof(std::max_align_t))
+      std::free(ptr);
+    else if (ptr)
+      std::free(static_cast<void **>(ptr)[-1]);
+  }
+
+private:
+  /// first multiple of align in block past the room for the address of block.
+  /// malloc blocks are aligned on max_align_t so there is always room for it.
+  static void *align_block(void *block, std::size_t align) noexcept {
+    if (!block)
+      return nullptr;
+    auto address = reinterpret_cast<std::uintptr_t>(block);
+    auto **ptr = reinterpret_cast<void **>((address + align) & ~(align - 1));
+    ptr[-1] = block;
+    return ptr;
+  }
+};
+
+/**
+ * @brief allocator mapping blocks of at least threshold bytes with mmap and
+ * asking for transparent huge pages, so large buffers need fewer TLB entries.
+ * smaller blocks come from aligned_allocator
+ */
+template <std::size_t threshold = std::size_t(2) << 20>
+struct huge_page_allocator : private aligned_allocator {
+  static constexpr std::size_t huge_page_size = std::size_t(2) << 20;
+
+  static std::size_t mapping_size(std::size_t size) noexcept {
+    return (size + huge_page_size - 1) / huge_page_size * huge_page_size;
+  }
+  void *allocate(std::size_t size, std::size_t align) noexcept {
+    if (size < threshold)
+      return aligned_allocator::allocate(size, align);
+    // mmap only aligns on a page, so map more and unmap the slack on both
+    // sides. huge pages are only used for aligned ranges, so the mapping is
+    // aligned on one at least
+    std::size_t map_align = std::max(align, huge_page_size);
+    std::size_t bytes = mapping_size(size);
+    if (bytes + map_align < bytes)
+      return nullptr;
+    void *map = ::mmap(nullptr, bytes + map_align, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (map == MAP_FAILED)
+      return nullptr;
+    auto *first = static_cast<std::byte *>(map);
+    auto *ptr = first + (map_align - reinterpret_cast<std::uintptr_t>(first) %
+                                         map_align) %
+                            map_align;
+    if (ptr != first)
+      ::munmap(first, ptr - first);
+    if (ptr + bytes != first + bytes + map_align)
+      ::munmap(ptr + bytes, first + map_align - ptr);
+#ifdef MADV_HUGEPAGE
+    ::madvise(ptr, bytes, MADV_HUGEPAGE);
+#endif
+    return ptr;
+  }
+  /// anonymous mappings are already zeroed.
+  void *allocate_zeroed(std::size_t size, std::size_t align) noexcept {
+    if (size < threshold)
+      return aligned_allocator::allocate_zeroed(size, align);
+    return allocate(size, align);
+  }
+  void deallocate(void *ptr, std::size_t size, std::size_t align) noexcept {
+    if (size < threshold)
+      aligned_allocator::deallocate(ptr, size, align);
+    else
+      ::munmap(ptr, mapping_size(size));
+  }
+};
+
+/**
+ * @brief allocator taking the storage from an llvm-style arena, like
+ * BumpPtrAllocatorImpl or StackedBumpAllocator, with an Allocate(size, align)
+ * and a Deallocate(ptr, size) member. the arena must outlive the buffer
+ */
+template <typename Arena> class arena_allocator {
+  Arena *_arena;
+
+public:
+  explicit arena_allocator(Arena &arena) noexcept : _arena{&arena} {}
+  void *allocate(std::size_t size, std::size_t align) {
+    return _arena->Allocate(size, align);
+  }
+  void deallocate(void *ptr, std::size_t size, std::size_t) noexcept {
+    _arena->Deallocate(ptr, size);
+  }
+  Arena &arena() const noexcept { return *_arena; }
+};
+
+/**
+ * @brief selects the overloads of fixed_buffer splitting the work across
+ * threads. like std::execution::par but without requiring a parallel backend
+ * to be linked
+ */
+struct parallel_policy {
+  /// number of threads, 0 for std::thread::hardware_concurrency().
+  unsigned thread_count = 0;
+};
+
+inline constexpr parallel_policy par{};
+
 namespace detail {
 
-auto build = [](auto) {};
+inline auto build = [](auto &) {};
 using _build = decltype(build);
 
+template <typename A, typename = void>
+struct has_allocate_zeroed : std::false_type {};
+
+template <typename A>
+struct has_allocate_zeroed<
+    A, std::void_t<decltype(std::declval<A &>().allocate_zeroed(
+           std::size_t{}, std::size_t{}))>> : std::true_type {};
+
+/// smallest number of elements worth a thread of its own.
+inline constexpr std::size_t min_parallel_chunk = 4096;
+
+inline std::size_t chunk_count(parallel_policy policy,
+                               std::size_t size) noexcept {
+  std::size_t threads = policy.thread_count
+                            ? policy.thread_count
+                            : std::thread::hardware_concurrency();
+  return std::clamp<std::size_t>(size / min_parallel_chunk, 1,
+                                 std::max<std::size_t>(threads, 1));
+}
+
+/// first element of the chunk idx when size elements are split in count
+/// chunks, chunk_begin(count, ...) is size.
+inline std::size_t chunk_begin(std::size_t idx, std::size_t count,
+                               std::size_t size) noexcept {
+  return size / count * idx + std::min(idx, size % count);
+}
+
+/**
+ * @brief call f(idx) for every chunk idx in [0, count), one thread per chunk.
+ * the calling thread runs the last chunk, and the chunks of threads that
+ * couldn't be started. f must not throw
+ */
+template <typename F> void run_chunks(std::size_t count, F &&f) noexcept {
+  std::vector<std::thread> threads;
+  std::size_t idx = 0;
+  try {
+    threads.reserve(count - 1);
+    for (; idx + 1 < count; idx++)
+      threads.emplace_back(f, idx);
+  } catch (...) {
+  }
+  for (; idx < count; idx++)
+    f(idx);
+  for (std::thread &thread : threads)
+    thread.join();
+}
+
 template <typename T> struct fixed_buffer_base {
 public:
   using value_type = T;
@@ -36,17 +223,36 @@ public:
 public:
   iterator _begin = nullptr;
   iterator _end = _begin;
+  size_type _capacity = 0;
+  /// threads destroying the elements with the buffer, more than 1 when it
+  /// was built with a parallel_policy.
+  unsigned _teardown_threads = 1;
 };
 
 } // namespace detail
 
 using detail::build;
 
-template <typename T>
-class fixed_buffer : protected detail::fixed_buffer_base<T> {
+/**
+ * @brief fixed capacity buffer, elements are never moved
+ * @tparam T type of the elements
+ * @tparam Align alignment of the storage, at least alignof(T). a cache line
+ * keeps elements of its size on a line of their own
+ * @tparam Allocator provides allocate(size, align) and
+ * deallocate(ptr, size, align), it is stored in the buffer. an optional
+ * allocate_zeroed(size, align) is used by zeroed()
+ */
+template <typename T, std::size_t Align = alignof(T),
+          typename Allocator = aligned_allocator>
+class fixed_buffer : protected detail::fixed_buffer_base<T>,
+                     private Allocator {
+  static_assert(Align >= alignof(T) && (Align & (Align - 1)) == 0,
+                "Align must be a power of 2 at least alignof(T)");
+
 private:
   using base = detail::fixed_buffer_base<T>;
   using base::_begin;
+  using base::_capacity;
   using base::_end;
   using base::is_noexcept_destructible;
 
@@ -58,17 +264,48 @@ public:
   using typename base::reference;
   using typename base::size_type;
   using typename base::value_type;
+  using allocator_type = Allocator;
+  static constexpr std::size_t alignment = Align;
 
 private:
   base &_data() { return *static_cast<base *>(this); }
-  static base init(iterator ptr) { return base{ptr, ptr}; }
+  Allocator &_alloc() noexcept { return *static_cast<Allocator *>(this); }
+  void allocate(size_type size, bool zero = false) {
+    if (size > max_size())
+      throw std::length_error("fixed_buffer size too large : " +
+                              std::to_string(size));
+    if (size == 0)
+      return;
+    std::size_t bytes = sizeof(value_type) * size;
+    void *ptr;
+    if (!zero)
+      ptr = _alloc().allocate(bytes, alignment);
+    else if constexpr (detail::has_allocate_zeroed<Allocator>::value)
+      ptr = _alloc().allocate_zeroed(bytes, alignment);
+    else if ((ptr = _alloc().allocate(bytes, alignment)))
+      std::memset(ptr, 0, bytes);
+    if (!ptr)
+      throw std::bad_alloc();
+    _begin = _end = static_cast<iterator>(ptr);
+    _capacity = size;
+  }
   void destroy_at(iterator it) noexcept(is_noexcept_destructible) {
     it->~value_type();
   }
+  /// destroy [first, last) in reverse order.
+  static void destroy_range(iterator first, iterator last) noexcept(
+      is_noexcept_destructible) {
+    if constexpr (!std::is_trivially_destructible_v<value_type>)
+      while (last != first)
+        (--last)->~value_type();
+  }
   void destroy() noexcept(is_noexcept_destructible) {
     if (_begin) {
-      clear();
-      std::free(_begin);
+      if (this->_teardown_threads > 1)
+        clear(parallel_policy{this->_teardown_threads});
+      else
+        clear();
+      _alloc().deallocate(_begin, sizeof(value_type) * _capacity, alignment);
     }
   }
   template <typename... Ts>
@@ -83,12 +320,44 @@ private:
 
 public:
   fixed_buffer() noexcept = default;
-  explicit fixed_buffer(size_type size)
-      : base{init(
-            static_cast<iterator>(std::malloc(sizeof(value_type) * size)))} {}
-  template <typename C, typename... Ts>
+  /// allocate room for size elements, throws std::length_error if size is
+  /// larger than max_size() and std::bad_alloc if the allocation fails.
+  explicit fixed_buffer(size_type size) { allocate(size); }
+  fixed_buffer(size_type size, const Allocator &alloc) : Allocator(alloc) {
+    allocate(size);
+  }
+  /**
+   * @brief buffer of size zero-initialized elements. the memory comes zeroed
+   * from the allocator when it can, so pages that are never written don't
+   * use physical memory
+   */
+  static fixed_buffer zeroed(size_type size,
+                             const Allocator &alloc = Allocator()) {
+    static_assert(std::is_trivially_default_constructible_v<value_type> &&
+                      std::is_trivially_destructible_v<value_type>,
+                  "zeroed requires a trivial type");
+    fixed_buffer buffer(0, alloc);
+    buffer.allocate(size, true);
+    buffer._end = buffer._begin + size;
+    return buffer;
+  }
+  /// empty buffer of capacity size whose elements are constructed in place
+  /// at uncommitted() and added with commit.
+  static fixed_buffer uninitialized(size_type size,
+                                    const Allocator &alloc = Allocator()) {
+    return fixed_buffer(size, alloc);
+  }
+  template <typename C, typename... Ts,
+            std::enable_if_t<!std::is_same_v<std::decay_t<C>, Allocator>,
+                             int> = 0>
   explicit fixed_buffer(size_type size, C &&c, Ts &&... ts)
-      : fixed_buffer(size) {
+      : fixed_buffer(std::allocator_arg, Allocator(), size,
+                     std::forward<C>(c), std::forward<Ts>(ts)...) {}
+  /// like fixed_buffer(size, c, ts...) with the storage from alloc.
+  template <typename C, typename... Ts>
+  fixed_buffer(std::allocator_arg_t, const Allocator &alloc, size_type size,
+               C &&c, Ts &&... ts)
+      : fixed_buffer(size, alloc) {
     if (size > 0) {
       for (; _end < _begin + size - 1; ++_end) {
         create_at(_end, ts...);
@@ -99,23 +368,80 @@ public:
       ++_end;
     }
   }
+  /**
+   * @brief like fixed_buffer(size, c, ts...) but the elements are split in
+   * chunks constructed by different threads, so c must be thread-safe. memory
+   * is first touched by the thread constructing it, which places fresh pages
+   * on its NUMA node. if a constructor or c throws, the elements already
+   * built are destroyed and the first exception is rethrown. the destructor
+   * then destroys the elements like clear(policy)
+   */
+  template <typename C, typename... Ts>
+  fixed_buffer(parallel_policy policy, size_type size, C &&c, Ts &&... ts)
+      : fixed_buffer(std::allocator_arg, Allocator(), policy, size,
+                     std::forward<C>(c), std::forward<Ts>(ts)...) {}
+  /// like fixed_buffer(policy, size, c, ts...) with the storage from alloc.
+  template <typename C, typename... Ts>
+  fixed_buffer(std::allocator_arg_t, const Allocator &alloc,
+               parallel_policy policy, size_type size, C &&c, Ts &&... ts)
+      : fixed_buffer(size, alloc) {
+    if (size == 0)
+      return;
+    std::size_t count = detail::chunk_count(policy, size);
+    std::vector<size_type> built(count, 0);
+    std::atomic<bool> failed{false};
+    std::exception_ptr error;
+    std::mutex error_mutex;
+    detail::run_chunks(count, [&](std::size_t idx) noexcept {
+      iterator first = _begin + detail::chunk_begin(idx, count, size);
+      iterator last = _begin + detail::chunk_begin(idx + 1, count, size);
+      iterator it = first;
+      try {
+        for (; it != last && !failed.load(std::memory_order_relaxed); ++it) {
+          create_at(it, ts...);
+          try {
+            c(*it);
+          } catch (...) {
+            destroy_at(it);
+            throw;
+          }
+        }
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(error_mutex);
+        if (!error)
+          error = std::current_exception();
+        failed.store(true, std::memory_order_relaxed);
+      }
+      built[idx] = it - first;
+    });
+    if (error) {
+      detail::run_chunks(count, [&](std::size_t idx) noexcept {
+        iterator first = _begin + detail::chunk_begin(idx, count, size);
+        destroy_range(first, first + built[idx]);
+      });
+      std::rethrow_exception(error);
+    }
+    _end = _begin + size;
+    this->_teardown_threads = unsigned(count);
+  }
   fixed_buffer(const fixed_buffer &) = delete;
   fixed_buffer operator=(const fixed_buffer &) = delete;
-  fixed_buffer(fixed_buffer &&other) noexcept {
-    this->_data() = other._data();
-    other._data() = {};
+  fixed_buffer(fixed_buffer &&other) noexcept
+      : Allocator(std::move(other._alloc())) {
+    this->_data() = std::exchange(other._data(), {});
   }
   fixed_buffer &
   operator=(fixed_buffer &&other) noexcept(is_noexcept_destructible) {
-    destroy();
-    this->_data() = other._data();
-    other._data() = {};
+    if (this != &other) {
+      destroy();
+      _alloc() = std::move(other._alloc());
+      this->_data() = std::exchange(other._data(), {});
+    }
     return *this;
   }
-  void swap(fixed_buffer &other) noexcept(is_noexcept_destructible) {
-    fixed_buffer tmp = other._data();
-    other._data() = this->_data();
-    this->_data() = tmp;
+  void swap(fixed_buffer &other) noexcept {
+    std::swap(this->_data(), other._data());
+    std::swap(_alloc(), other._alloc());
   }
   reference operator[](size_type pos) noexcept { return _begin[pos]; }
   const_reference operator[](size_type pos) const noexcept {
@@ -150,12 +476,38 @@ public:
     _end--;
   }
   void clear() noexcept(is_noexcept_destructible) {
-    _end--;
-    for (; _end != _begin; --_end)
-      destroy_at(_end);
+    destroy_range(_begin, _end);
+    _end = _begin;
+  }
+  /// destroy the elements in chunks on different threads, a destructor that
+  /// throws calls std::terminate.
+  void clear(parallel_policy policy) noexcept {
+    if constexpr (!std::is_trivially_destructible_v<value_type>) {
+      size_type count = detail::chunk_count(policy, size());
+      if (count > 1)
+        detail::run_chunks(count, [&](std::size_t idx) noexcept {
+          destroy_range(_begin + detail::chunk_begin(idx, count, size()),
+                        _begin + detail::chunk_begin(idx + 1, count, size()));
+        });
+      else
+        destroy_range(_begin, _end);
+    }
+    _end = _begin;
   }
   void resize(size_type size) noexcept { _end = _begin + size; }
+  /// first slot past the elements, where elements are built before commit.
+  iterator uncommitted() noexcept { return _end; }
+  /// add the count elements constructed in place from uncommitted().
+  void commit(size_type count) noexcept {
+    assert(count <= _capacity - size() && "commit past the capacity");
+    _end += count;
+  }
   size_type size() const noexcept { return _end - _begin; }
+  size_type capacity() const noexcept { return _capacity; }
+  static constexpr size_type max_size() noexcept {
+    return PTRDIFF_MAX / sizeof(value_type);
+  }
+  const Allocator &get_allocator() const noexcept { return *this; }
   iterator begin() noexcept { return _begin; }
   const_iterator begin() const noexcept { return _begin; }
   iterator end() noexcept { return _end; }
@@ -0,0 +1,195 @@
+/*
+ * fixed capacity buffer storing a record as one array per field, all arrays
+ * share a single allocation. like fixed_buffer elements are never moved so
+ * fields can be non-copyable and non-movable
+ */
+
+#ifndef UTILS_FIXED_SOA_BUFFER_HPP
+#define UTILS_FIXED_SOA_BUFFER_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "span.hpp"
+
+namespace utils {
+
+template <typename... Fields> class fixed_soa_buffer {
+  static_assert(sizeof...(Fields) > 0, "at least one field is required");
+
+public:
+  using size_type = std::size_t;
+  template <std::size_t I>
+  using field_type = std::tuple_element_t<I, std::tuple<Fields...>>;
+  /// proxy on one record, std::get and structured bindings give the fields.
+  using reference = std::tuple<Fields &...>;
+  using const_reference = std::tuple<const Fields &...>;
+  /// alignment of each field array, a cache line so that loops over a field
+  /// can be vectorized without a peeling prologue.
+  static constexpr std::size_t field_alignment =
+      std::max({std::size_t(64), alignof(Fields)...});
+  static constexpr bool is_noexcept_destructible =
+      (std::is_nothrow_destructible_v<Fields> && ...);
+
+private:
+  using indexes = std::index_sequence_for<Fields...>;
+  static constexpr std::size_t field_count = sizeof...(Fields);
+  void *_block = nullptr;
+  void *_fields[field_count] = {};
+  size_type _size = 0;
+  size_type _capacity = 0;
+
+  static std::size_t align_up(std::size_t value) noexcept {
+    return (value + field_alignment - 1) / field_alignment * field_alignment;
+  }
+  template <std::size_t I> field_type<I> *field_ptr() const noexcept {
+    return static_cast<field_type<I> *>(_fields[I]);
+  }
+  template <std::size_t... Is>
+  void layout(std::byte *block, std::index_sequence<Is...>) noexcept {
+    std::size_t offset = 0;
+    ((_fields[Is] = block + offset,
+      offset += align_up(sizeof(field_type<Is>) * _capacity)),
+     ...);
+  }
+  template <std::size_t... Is>
+  void destroy_at(size_type pos, std::index_sequence<Is...>) noexcept(
+      is_noexcept_destructible) {
+    (field_ptr<Is>()[pos].~field_type<Is>(), ...);
+  }
+  /// construct the fields from I of the record at pos from args or
+  /// value-initialize them if args is empty, fields already built are
+  /// destroyed if one throws.
+  template <std::size_t I, typename Args>
+  void create_at(size_type pos, Args &&args) {
+    if constexpr (I < field_count) {
+      if constexpr (std::tuple_size_v<std::decay_t<Args>> == 0)
+        new (field_ptr<I>() + pos) field_type<I>();
+      else
+        new (field_ptr<I>() + pos)
+            field_type<I>(std::get<I>(std::move(args)));
+      try {
+        create_at<I + 1>(pos, std::move(args));
+      } catch (...) {
+        field_ptr<I>()[pos].~field_type<I>();
+        throw;
+      }
+    }
+  }
+  template <std::size_t... Is>
+  reference at_impl(size_type pos, std::index_sequence<Is...>) const noexcept {
+    return reference(field_ptr<Is>()[pos]...);
+  }
+  void destroy() noexcept(is_noexcept_destructible) {
+    if (_block) {
+      clear();
+      std::free(_block);
+    }
+  }
+  std::string out_range_msg(size_type pos,
+                            const std::string &position) const {
+    return ("out of range : " + std::to_string(pos) +
+            " >= " + std::to_string(size()) + " in " + position);
+  }
+
+public:
+  fixed_soa_buffer() noexcept = default;
+  /// allocate room for capacity records in a single block, throws
+  /// std::length_error if capacity is larger than max_size().
+  explicit fixed_soa_buffer(size_type capacity) : _capacity{capacity} {
+    if (capacity > max_size())
+      throw std::length_error("fixed_soa_buffer size too large : " +
+                              std::to_string(capacity));
+    // every term is a multiple of field_alignment, as aligned_alloc requires
+    std::size_t total = (align_up(sizeof(Fields) * capacity) + ... + 0);
+    if (!total)
+      return;
+    _block = std::aligned_alloc(field_alignment, total);
+    if (!_block)
+      throw std::bad_alloc();
+    layout(static_cast<std::byte *>(_block), indexes{});
+  }
+  fixed_soa_buffer(const fixed_soa_buffer &) = delete;
+  fixed_soa_buffer &operator=(const fixed_soa_buffer &) = delete;
+  fixed_soa_buffer(fixed_soa_buffer &&other) noexcept
+      : _block{std::exchange(other._block, nullptr)},
+        _size{std::exchange(other._size, 0)},
+        _capacity{std::exchange(other._capacity, 0)} {
+    std::copy(std::begin(other._fields), std::end(other._fields), _fields);
+  }
+  fixed_soa_buffer &
+  operator=(fixed_soa_buffer &&other) noexcept(is_noexcept_destructible) {
+    if (this != &other) {
+      destroy();
+      new (this) fixed_soa_buffer(std::move(other));
+    }
+    return *this;
+  }
+  /**
+   * @brief construct a record at the end, field i is constructed from ts_i or
+   * value-initialized if ts is empty. there must be room for it
+   * @return proxy on the new record
+   */
+  template <typename... Ts> reference emplace(Ts &&... ts) {
+    static_assert(sizeof...(Ts) == 0 || sizeof...(Ts) == field_count,
+                  "one argument per field is required");
+    create_at<0>(_size, std::forward_as_tuple(std::forward<Ts>(ts)...));
+    return (*this)[_size++];
+  }
+  void pop_back() noexcept(is_noexcept_destructible) {
+    destroy_at(--_size, indexes{});
+  }
+  void clear() noexcept(is_noexcept_destructible) {
+    while (_size)
+      pop_back();
+  }
+  reference operator[](size_type pos) noexcept {
+    return at_impl(pos, indexes{});
+  }
+  const_reference operator[](size_type pos) const noexcept {
+    return at_impl(pos, indexes{});
+  }
+  reference at(size_type pos) {
+    if (pos < size())
+      return (*this)[pos];
+    throw std::out_of_range(out_range_msg(pos, __PRETTY_FUNCTION__));
+  }
+  const_reference at(size_type pos) const {
+    if (pos < size())
+      return (*this)[pos];
+    throw std::out_of_range(out_range_msg(pos, __PRETTY_FUNCTION__));
+  }
+  /// contiguous array of the field I of every record, aligned on
+  /// field_alignment.
+  template <std::size_t I> sg::span<field_type<I>> field() noexcept {
+    return {field_ptr<I>(), _size};
+  }
+  template <std::size_t I>
+  sg::span<const field_type<I>> field() const noexcept {
+    return {field_ptr<I>(), _size};
+  }
+  reference back() noexcept { return (*this)[_size - 1]; }
+  const_reference back() const noexcept { return (*this)[_size - 1]; }
+  size_type size() const noexcept { return _size; }
+  size_type capacity() const noexcept { return _capacity; }
+  /// largest capacity whose block size, padding included, fits in a
+  /// ptrdiff_t.
+  static constexpr size_type max_size() noexcept {
+    return (PTRDIFF_MAX - field_count * field_alignment) /
+           (sizeof(Fields) + ...);
+  }
+  [[nodiscard]] bool empty() const noexcept { return _size == 0; }
+  ~fixed_soa_buffer() noexcept(is_noexcept_destructible) { destroy(); }
+};
+
+} // namespace utils
+
+#endif // UTILS_FIXED_SOA_BUFFER_HPP
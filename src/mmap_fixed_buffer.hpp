@@ -0,0 +1,272 @@
+/*
+ * fixed capacity buffer of trivially copyable elements stored in a memory
+ * mapped file. a buffer written by one process is reopened by the next one
+ * with a single mmap instead of being rebuilt
+ */
+
+#ifndef UTILS_MMAP_FIXED_BUFFER_HPP
+#define UTILS_MMAP_FIXED_BUFFER_HPP
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <system_error>
+#include <type_traits>
+#include <unistd.h>
+#include <utility>
+
+namespace utils {
+
+/// how an existing file is mapped.
+enum class mmap_mode {
+  /// writes go to the file.
+  read_write,
+  read_only,
+  /// writes stay private to the process and are lost when it is unmapped.
+  copy_on_write,
+};
+
+namespace detail {
+
+/// at the start of the file, the elements follow at the next multiple of
+/// the element alignment and of a cache line.
+struct mmap_buffer_header {
+  static constexpr char file_magic[8] = {'S', 'G', 'F', 'X',
+                                         'B', 'U', 'F', '\0'};
+  static constexpr std::uint32_t current_version = 1;
+
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t element_size;
+  std::uint32_t element_align;
+  std::uint32_t reserved;
+  std::uint64_t count;
+  std::uint64_t capacity;
+};
+
+/// close fd when it goes out of scope.
+struct fd_guard {
+  int fd;
+  ~fd_guard() {
+    if (fd >= 0)
+      ::close(fd);
+  }
+};
+
+[[noreturn]] inline void throw_errno(const std::string &what) {
+  throw std::system_error(errno, std::generic_category(), what);
+}
+
+} // namespace detail
+
+/**
+ * @brief fixed_buffer backed by a file. the header of the file records the
+ * element size and alignment, the number of elements and a format version,
+ * they are checked when the file is reopened
+ * @tparam T trivially copyable type of the elements, it is read back from the
+ * file as is so it must not contain pointers
+ */
+template <typename T> class mmap_fixed_buffer {
+  static_assert(std::is_trivially_copyable_v<T>,
+                "mmap_fixed_buffer requires trivially copyable types");
+  static_assert(alignof(T) <= 4096, "alignment larger than a page");
+
+public:
+  using value_type = T;
+  using size_type = std::size_t;
+  using reference = value_type &;
+  using const_reference = const value_type &;
+  using iterator = value_type *;
+  using const_iterator = const value_type *;
+  using header_type = detail::mmap_buffer_header;
+  static constexpr std::size_t data_align =
+      std::max<std::size_t>(64, alignof(T));
+  /// offset of the first element in the file.
+  static constexpr std::size_t data_offset =
+      (sizeof(header_type) + data_align - 1) / data_align * data_align;
+
+private:
+  void *_map = nullptr;
+  std::size_t _map_size = 0;
+  mmap_mode _mode = mmap_mode::read_only;
+
+  header_type &header() const noexcept {
+    return *static_cast<header_type *>(_map);
+  }
+  T *elements() const noexcept {
+    return reinterpret_cast<T *>(static_cast<std::byte *>(_map) + data_offset);
+  }
+  static std::size_t file_size(size_type capacity) {
+    if (capacity > (SIZE_MAX - data_offset) / sizeof(T))
+      throw std::length_error("mmap_fixed_buffer size too large : " +
+                              std::to_string(capacity));
+    return data_offset + capacity * sizeof(T);
+  }
+  mmap_fixed_buffer(int fd, std::size_t size, mmap_mode mode,
+                    const std::string &path)
+      : _map_size{size}, _mode{mode} {
+    int prot = mode == mmap_mode::read_only ? PROT_READ
+                                            : PROT_READ | PROT_WRITE;
+    int flags = mode == mmap_mode::copy_on_write ? MAP_PRIVATE : MAP_SHARED;
+    void *map = ::mmap(nullptr, size, prot, flags, fd, 0);
+    if (map == MAP_FAILED)
+      detail::throw_errno("mmap " + path);
+    _map = map;
+  }
+  void check_header(const std::string &path) const {
+    auto invalid = [&](const std::string &why) {
+      return std::runtime_error("invalid mmap_fixed_buffer file " + path +
+                                " : " + why);
+    };
+    const header_type &head = header();
+    if (_map_size < sizeof(header_type) ||
+        std::memcmp(head.magic, header_type::file_magic,
+                    sizeof(head.magic)) != 0)
+      throw invalid("bad magic");
+    if (head.version != header_type::current_version)
+      throw invalid("unsupported version " + std::to_string(head.version));
+    if (head.element_size != sizeof(T) || head.element_align != alignof(T))
+      throw invalid("element type mismatch");
+    if (head.count > head.capacity ||
+        head.capacity > (_map_size - data_offset) / sizeof(T))
+      throw invalid("truncated file");
+  }
+  std::string out_range_msg(size_type pos, const std::string &position) const {
+    return ("out of range : " + std::to_string(pos) +
+            " >= " + std::to_string(size()) + " in " + position);
+  }
+
+public:
+  mmap_fixed_buffer() noexcept = default;
+  /**
+   * @brief create or truncate the file at path and map it with room for
+   * capacity elements. pages are allocated in the file as they are written
+   */
+  static mmap_fixed_buffer create(const std::string &path,
+                                  size_type capacity) {
+    std::size_t size = file_size(capacity);
+    detail::fd_guard file{::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC,
+                                 0644)};
+    if (file.fd < 0)
+      detail::throw_errno("open " + path);
+    if (::ftruncate(file.fd, size) != 0)
+      detail::throw_errno("ftruncate " + path);
+    mmap_fixed_buffer buffer(file.fd, size, mmap_mode::read_write, path);
+    header_type &head = buffer.header();
+    std::memcpy(head.magic, header_type::file_magic, sizeof(head.magic));
+    head.version = header_type::current_version;
+    head.element_size = sizeof(T);
+    head.element_align = alignof(T);
+    head.reserved = 0;
+    head.count = 0;
+    head.capacity = capacity;
+    return buffer;
+  }
+  /**
+   * @brief map a file written by create. throws std::system_error if it
+   * can't be mapped and std::runtime_error if its header doesn't match T
+   */
+  static mmap_fixed_buffer open(const std::string &path,
+                                mmap_mode mode = mmap_mode::read_only) {
+    detail::fd_guard file{::open(
+        path.c_str(), mode == mmap_mode::read_write ? O_RDWR : O_RDONLY)};
+    if (file.fd < 0)
+      detail::throw_errno("open " + path);
+    struct stat info;
+    if (::fstat(file.fd, &info) != 0)
+      detail::throw_errno("fstat " + path);
+    if (std::size_t(info.st_size) < data_offset)
+      throw std::runtime_error("invalid mmap_fixed_buffer file " + path +
+                               " : truncated file");
+    mmap_fixed_buffer buffer(file.fd, info.st_size, mode, path);
+    buffer.check_header(path);
+    return buffer;
+  }
+  mmap_fixed_buffer(const mmap_fixed_buffer &) = delete;
+  mmap_fixed_buffer &operator=(const mmap_fixed_buffer &) = delete;
+  mmap_fixed_buffer(mmap_fixed_buffer &&other) noexcept
+      : _map{std::exchange(other._map, nullptr)},
+        _map_size{std::exchange(other._map_size, 0)}, _mode{other._mode} {}
+  mmap_fixed_buffer &operator=(mmap_fixed_buffer &&other) noexcept {
+    if (this != &other) {
+      this->~mmap_fixed_buffer();
+      new (this) mmap_fixed_buffer(std::move(other));
+    }
+    return *this;
+  }
+  /// add an element at the end, throws std::length_error if the buffer is
+  /// full. the buffer must be writable.
+  template <typename... Ts> reference emplace(Ts &&... ts) {
+    assert(writable() && "emplace on a read-only mmap_fixed_buffer");
+    if (size() == capacity())
+      throw std::length_error("mmap_fixed_buffer is full : capacity " +
+                              std::to_string(capacity()));
+    T *ptr = new (elements() + size()) T(std::forward<Ts>(ts)...);
+    header().count++;
+    return *ptr;
+  }
+  void pop_back() noexcept {
+    assert(writable() && !empty());
+    header().count--;
+  }
+  void clear() noexcept {
+    assert(writable());
+    header().count = 0;
+  }
+  /**
+   * @brief write the modified pages back to the file and wait for the
+   * writes. does nothing for read-only and copy-on-write mappings
+   */
+  void sync() {
+    if (_mode == mmap_mode::read_write && ::msync(_map, _map_size, MS_SYNC))
+      detail::throw_errno("msync");
+  }
+  reference operator[](size_type pos) noexcept { return elements()[pos]; }
+  const_reference operator[](size_type pos) const noexcept {
+    return elements()[pos];
+  }
+  reference at(size_type pos) {
+    if (pos < size())
+      return (*this)[pos];
+    throw std::out_of_range(out_range_msg(pos, __PRETTY_FUNCTION__));
+  }
+  const_reference at(size_type pos) const {
+    if (pos < size())
+      return (*this)[pos];
+    throw std::out_of_range(out_range_msg(pos, __PRETTY_FUNCTION__));
+  }
+  T *data() noexcept { return _map ? elements() : nullptr; }
+  const T *data() const noexcept { return _map ? elements() : nullptr; }
+  iterator begin() noexcept { return data(); }
+  const_iterator begin() const noexcept { return data(); }
+  iterator end() noexcept { return data() + size(); }
+  const_iterator end() const noexcept { return data() + size(); }
+  reference back() noexcept { return elements()[size() - 1]; }
+  const_reference back() const noexcept { return elements()[size() - 1]; }
+  size_type size() const noexcept { return _map ? header().count : 0; }
+  size_type capacity() const noexcept { return _map ? header().capacity : 0; }
+  [[nodiscard]] bool empty() const noexcept { return size() == 0; }
+  mmap_mode mode() const noexcept { return _mode; }
+  bool writable() const noexcept {
+    return _map && _mode != mmap_mode::read_only;
+  }
+  /// unmap the file, the kernel writes back pages modified in read_write
+  /// mode even without a sync.
+  ~mmap_fixed_buffer() {
+    if (_map)
+      ::munmap(_map, _map_size);
+  }
+};
+
+} // namespace utils
+
+#endif // UTILS_MMAP_FIXED_BUFFER_HPP
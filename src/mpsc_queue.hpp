@@ -0,0 +1,264 @@
+/*
+ * multi-producer single-consumer queues of any_callable tasks. tasks are
+ * stored inline in cache-line aligned slots and run in place by the consumer
+ */
+
+#ifndef UTILS_MPSC_QUEUE_HPP
+#define UTILS_MPSC_QUEUE_HPP
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+#include "any_callable.hpp"
+
+namespace sg {
+
+inline constexpr std::size_t cache_line_size = 64;
+
+namespace detail {
+
+template <std::size_t sbo_size>
+using queue_task = any_callable<void() &&, sbo_size>;
+
+/// build the task before claiming a slot unless it can be built in place
+/// without throwing, a slot that has been claimed must be published.
+template <typename Task, typename F>
+constexpr bool queue_build_in_place =
+    Task::template fit_sbo<F> &&
+    std::is_nothrow_constructible_v<std::decay_t<F>, F>;
+
+} // namespace detail
+
+/**
+ * @brief bounded queue based on a ring of sequenced slots. push never
+ * allocates for tasks that fit in the sbo
+ * @tparam sbo_size size of the sbo of the tasks, the default makes a slot fit
+ * in a cache line
+ */
+template <std::size_t sbo_size = 32> class bounded_mpsc_queue {
+public:
+  using task_type = detail::queue_task<sbo_size>;
+
+private:
+  struct alignas(cache_line_size) slot {
+    std::atomic<std::size_t> sequence;
+    task_type task;
+  };
+  std::unique_ptr<slot[]> _slots;
+  std::size_t _mask;
+  alignas(cache_line_size) std::atomic<std::size_t> _tail{0};
+  alignas(cache_line_size) std::size_t _head = 0;
+
+  slot *claim(std::size_t &pos) noexcept {
+    pos = _tail.load(std::memory_order_relaxed);
+    while (true) {
+      slot &s = _slots[pos & _mask];
+      std::size_t seq = s.sequence.load(std::memory_order_acquire);
+      std::ptrdiff_t diff = std::ptrdiff_t(seq) - std::ptrdiff_t(pos);
+      if (diff == 0) {
+        if (_tail.compare_exchange_weak(pos, pos + 1,
+                                        std::memory_order_relaxed))
+          return &s;
+      } else if (diff < 0)
+        return nullptr;
+      else
+        pos = _tail.load(std::memory_order_relaxed);
+    }
+  }
+  /// hand the slot back to producers once the task has run, even if it
+  /// threw.
+  struct release_slot {
+    bounded_mpsc_queue &queue;
+    slot &s;
+    ~release_slot() {
+      s.sequence.store(queue._head + queue._mask + 1,
+                       std::memory_order_release);
+      queue._head++;
+    }
+  };
+
+public:
+  /**
+   * @param capacity maximum number of pending tasks, rounded up to a power
+   * of 2
+   */
+  explicit bounded_mpsc_queue(std::size_t capacity) {
+    std::size_t size = 1;
+    while (size < capacity)
+      size *= 2;
+    _slots.reset(new slot[size]);
+    _mask = size - 1;
+    for (std::size_t idx = 0; idx < size; idx++)
+      _slots[idx].sequence.store(idx, std::memory_order_relaxed);
+  }
+  bounded_mpsc_queue(const bounded_mpsc_queue &) = delete;
+  bounded_mpsc_queue &operator=(const bounded_mpsc_queue &) = delete;
+  /**
+   * @brief enqueue f, can be called from any thread
+   * @return false if the queue is full
+   */
+  template <typename F> bool try_push(F &&f) {
+    if constexpr (detail::queue_build_in_place<task_type, F>) {
+      std::size_t pos;
+      slot *s = claim(pos);
+      if (!s)
+        return false;
+      s->task = std::forward<F>(f);
+      s->sequence.store(pos + 1, std::memory_order_release);
+    } else {
+      task_type task(std::forward<F>(f));
+      std::size_t pos;
+      slot *s = claim(pos);
+      if (!s)
+        return false;
+      s->task = std::move(task);
+      s->sequence.store(pos + 1, std::memory_order_release);
+    }
+    return true;
+  }
+  /**
+   * @brief run the oldest task in place, must only be called from the
+   * consumer thread
+   * @return false if no task was ready
+   */
+  bool try_run_one() {
+    slot &s = _slots[_head & _mask];
+    if (s.sequence.load(std::memory_order_acquire) != _head + 1)
+      return false;
+    release_slot release{*this, s};
+    std::move(s.task)();
+    return true;
+  }
+  /// run tasks until none is ready, return the number of tasks run.
+  std::size_t run_all() {
+    std::size_t count = 0;
+    while (try_run_one())
+      count++;
+    return count;
+  }
+  std::size_t capacity() const noexcept { return _mask + 1; }
+};
+
+/**
+ * @brief unbounded queue based on a linked list of cache-line aligned nodes.
+ * nodes are recycled from the consumer to the producers so push doesn't
+ * allocate in steady state for tasks that fit in the sbo
+ * @tparam sbo_size size of the sbo of the tasks
+ */
+template <std::size_t sbo_size = 32> class mpsc_queue {
+public:
+  using task_type = detail::queue_task<sbo_size>;
+
+private:
+  struct alignas(cache_line_size) node {
+    std::atomic<node *> next{nullptr};
+    task_type task;
+  };
+  /// nodes owned by a producer thread, shared by all queues with the same
+  /// node type.
+  struct node_cache {
+    node *first = nullptr;
+    node *pop() noexcept {
+      node *n = first;
+      if (n)
+        first = n->next.load(std::memory_order_relaxed);
+      return n;
+    }
+    ~node_cache() {
+      while (node *n = pop())
+        delete n;
+    }
+  };
+  static node_cache &local_cache() {
+    static thread_local node_cache cache;
+    return cache;
+  }
+  alignas(cache_line_size) std::atomic<node *> _tail;
+  /// nodes released by the consumer, producers take the whole list at once
+  /// so there is no ABA problem.
+  alignas(cache_line_size) std::atomic<node *> _free{nullptr};
+  alignas(cache_line_size) node *_head;
+
+  node *alloc_node() {
+    node_cache &cache = local_cache();
+    node *n = cache.pop();
+    if (!n) {
+      cache.first = _free.exchange(nullptr, std::memory_order_acquire);
+      n = cache.pop();
+    }
+    if (!n)
+      n = new node;
+    n->next.store(nullptr, std::memory_order_relaxed);
+    return n;
+  }
+  void recycle(node *n) noexcept {
+    node *first = _free.load(std::memory_order_relaxed);
+    do
+      n->next.store(first, std::memory_order_relaxed);
+    while (!_free.compare_exchange_weak(first, n, std::memory_order_release,
+                                        std::memory_order_relaxed));
+  }
+  void link(node *n) noexcept {
+    node *prev = _tail.exchange(n, std::memory_order_acq_rel);
+    prev->next.store(n, std::memory_order_release);
+  }
+  static void delete_list(node *n) noexcept {
+    while (n) {
+      node *next = n->next.load(std::memory_order_relaxed);
+      delete n;
+      n = next;
+    }
+  }
+
+public:
+  mpsc_queue() : _tail{new node}, _head{_tail.load()} {}
+  mpsc_queue(const mpsc_queue &) = delete;
+  mpsc_queue &operator=(const mpsc_queue &) = delete;
+  /// enqueue f, can be called from any thread.
+  template <typename F> void push(F &&f) {
+    if constexpr (detail::queue_build_in_place<task_type, F>) {
+      node *n = alloc_node();
+      n->task = std::forward<F>(f);
+      link(n);
+    } else {
+      task_type task(std::forward<F>(f));
+      node *n = alloc_node();
+      n->task = std::move(task);
+      link(n);
+    }
+  }
+  /**
+   * @brief run the oldest task in place, must only be called from the
+   * consumer thread
+   * @return false if no task was ready
+   */
+  bool try_run_one() {
+    node *next = _head->next.load(std::memory_order_acquire);
+    if (!next)
+      return false;
+    recycle(_head);
+    _head = next;
+    // next is now the stub node, its task is consumed by the call
+    std::move(next->task)();
+    return true;
+  }
+  /// run tasks until none is ready, return the number of tasks run.
+  std::size_t run_all() {
+    std::size_t count = 0;
+    while (try_run_one())
+      count++;
+    return count;
+  }
+  ~mpsc_queue() {
+    delete_list(_head);
+    delete_list(_free.load(std::memory_order_relaxed));
+  }
+};
+
+} // namespace sg
+
+#endif // UTILS_MPSC_QUEUE_HPP
@@ -6,16 +6,37 @@
 #define UTILS_SBO_BASE_HPP
 
 #include <cstddef>
+#include <cstdint>
 #include <cstdlib>
 #include <memory>
+#include <new>
+#include <utility>
 
 namespace sg {
 
+namespace detail {
+
+/// type-erased operations on an object stored in an sbo_base.
+template <typename T> void destroy_func(void *data) noexcept {
+  static_cast<T *>(data)->~T();
+}
+
+template <typename T> void move_func(void *from, void *to) noexcept {
+  new (to) T(std::move(*static_cast<T *>(from)));
+}
+
+} // namespace detail
+
 struct malloc_allocator {
   void *allocate(std::size_t size) noexcept { return std::malloc(size); }
   void deallocate(void *ptr) noexcept { std::free(ptr); }
 };
 
+/**
+ * @brief storage for a single object, in the sbo if it fits and in a heap block
+ * otherwise. the heap block is kept when the object is destroyed with clear so
+ * that the next object reuses it if it fits
+ */
 template <std::size_t sbo_buff_size,
           std::size_t sbo_buff_align = alignof(max_align_t),
           typename Allocator = malloc_allocator>
@@ -25,7 +46,10 @@ protected:
     alignas(sbo_buff_align) std::byte _sbo_buff[sbo_buff_size];
     void *_alloced_ptr = nullptr;
   };
+  /// size of the object, 0 if there is none.
   std::size_t _size = 0;
+  /// size of the heap block, 0 if the sbo is used.
+  std::size_t _capacity = 0;
   void destroy() noexcept {
     if (!is_sbo())
       this->deallocate(_alloced_ptr);
@@ -33,30 +57,199 @@ protected:
   sbo_base() = default;
   sbo_base(const sbo_base &) = delete;
   sbo_base &operator=(const sbo_base &) = delete;
+  /**
+   * @brief get storage for an object of size bytes. the current heap block is
+   * reused if it is big enough, there must be no object
+   * @return nullptr if the allocation failed
+   */
   void *alloc(std::size_t size) noexcept {
-    destroy();
-    _size = size;
-    if (size > sbo_buff_size) {
+    if (size <= sbo_buff_size) {
+      free();
+      _size = size;
+      return (void *)&(_sbo_buff[0]);
+    }
+    if (size > _capacity) {
+      free();
       _alloced_ptr = this->allocate(size);
-      return _alloced_ptr;
+      if (!_alloced_ptr)
+        return nullptr;
+      _capacity = size;
     }
-    return (void *)&(_sbo_buff[0]);
+    _size = size;
+    return _alloced_ptr;
   }
   void *ptr() const noexcept {
-    if (_size > sbo_buff_size)
+    if (!is_sbo())
       return _alloced_ptr;
     return (void *)&(_sbo_buff[0]);
   }
   std::size_t size() const noexcept { return _size; }
+  std::size_t capacity() const noexcept {
+    return is_sbo() ? sbo_buff_size : _capacity;
+  }
+  /// the object was destroyed, keep the heap block for the next one.
+  void clear() noexcept { _size = 0; }
+  /// the object was destroyed, release the heap block.
   void free() noexcept {
     destroy();
     _size = 0;
+    _capacity = 0;
     _alloced_ptr = nullptr;
   }
-  bool is_sbo() const noexcept { return _size <= sbo_buff_size; }
+  /// take the heap block and the object in it from other.
+  void steal(sbo_base &other) noexcept {
+    free();
+    _alloced_ptr = other._alloced_ptr;
+    _size = other._size;
+    _capacity = other._capacity;
+    other._size = 0;
+    other._capacity = 0;
+  }
+  /**
+   * @brief release the heap block if there is no object, or move the object
+   * to a block of its size
+   * @param relocate moves the object from its first argument to its second
+   * and destroys the source
+   */
+  template <typename Relocate>
+  void shrink_to_fit(Relocate &&relocate) noexcept {
+    if (is_sbo() || _size == _capacity)
+      return;
+    if (!_size) {
+      free();
+      return;
+    }
+    void *ptr = this->allocate(_size);
+    if (!ptr)
+      return;
+    relocate(_alloced_ptr, ptr);
+    destroy();
+    _alloced_ptr = ptr;
+    _capacity = _size;
+  }
+  bool is_sbo() const noexcept { return _capacity == 0; }
   ~sbo_base() noexcept { destroy(); }
 };
 
+/**
+ * @brief compact variant of sbo_base for types that keep a pointer to a table
+ * of operations. the heap flag is stored in the low bit of the table pointer
+ * and the capacity of the heap block next to its pointer in the sbo, so only
+ * one word is added to the buffer. the size of the object is not stored, the
+ * table has it. objects whose alignment is larger than a pointer are stored
+ * on the heap
+ * @tparam Ops table of operations, it must have a size member
+ */
+template <std::size_t sbo_buff_size, typename Ops,
+          typename Allocator = malloc_allocator>
+class compact_sbo_base : private Allocator {
+  static constexpr std::uintptr_t heap_bit = 1;
+  static_assert(alignof(Ops) > heap_bit, "the low bit of Ops* must be free");
+
+protected:
+  static constexpr std::size_t sbo_buff_align = alignof(void *);
+  struct heap_block {
+    void *ptr;
+    std::size_t capacity;
+  };
+  union {
+    alignas(sbo_buff_align) std::byte _sbo_buff[sbo_buff_size];
+    heap_block _heap;
+  };
+  std::uintptr_t _ops_and_flag = 0;
+
+  void destroy() noexcept {
+    if (!is_sbo())
+      this->deallocate(_heap.ptr);
+  }
+  compact_sbo_base() = default;
+  compact_sbo_base(const compact_sbo_base &) = delete;
+  compact_sbo_base &operator=(const compact_sbo_base &) = delete;
+  static constexpr bool fits(std::size_t size, std::size_t align) noexcept {
+    return size <= sbo_buff_size && align <= sbo_buff_align;
+  }
+  const Ops *ops() const noexcept {
+    return reinterpret_cast<const Ops *>(_ops_and_flag & ~heap_bit);
+  }
+  void set_ops(const Ops *ops) noexcept {
+    _ops_and_flag =
+        reinterpret_cast<std::uintptr_t>(ops) | (_ops_and_flag & heap_bit);
+  }
+  /**
+   * @brief get storage for an object of size bytes. the current heap block is
+   * reused if it is big enough, there must be no object
+   * @return nullptr if the allocation failed
+   */
+  void *alloc(std::size_t size, std::size_t align) noexcept {
+    if (fits(size, align))
+      return alloc_sbo();
+    if (is_sbo() || size > _heap.capacity) {
+      free();
+      void *ptr = this->allocate(size);
+      if (!ptr)
+        return nullptr;
+      _heap = {ptr, size};
+    }
+    _ops_and_flag = heap_bit;
+    return _heap.ptr;
+  }
+  /// release the heap block and return the sbo.
+  void *alloc_sbo() noexcept {
+    free();
+    return (void *)&(_sbo_buff[0]);
+  }
+  void *ptr() const noexcept {
+    if (!is_sbo())
+      return _heap.ptr;
+    return (void *)&(_sbo_buff[0]);
+  }
+  std::size_t capacity() const noexcept {
+    return is_sbo() ? sbo_buff_size : _heap.capacity;
+  }
+  /// the object was destroyed, keep the heap block for the next one.
+  void clear() noexcept { _ops_and_flag &= heap_bit; }
+  /// the object was destroyed, release the heap block.
+  void free() noexcept {
+    destroy();
+    _ops_and_flag = 0;
+  }
+  /// take the heap block and the object in it from other.
+  template <std::size_t other_size>
+  void steal(compact_sbo_base<other_size, Ops, Allocator> &other) noexcept {
+    free();
+    _heap = other._heap;
+    _ops_and_flag = other._ops_and_flag;
+    other._ops_and_flag = 0;
+  }
+  /**
+   * @brief release the heap block if there is no object, or move the object
+   * to a block of its size
+   * @param relocate moves the object from its first argument to its second
+   * and destroys the source
+   */
+  template <typename Relocate>
+  void shrink_to_fit(Relocate &&relocate) noexcept {
+    if (is_sbo())
+      return;
+    if (!ops()) {
+      free();
+      return;
+    }
+    std::size_t size = ops()->size;
+    if (size == _heap.capacity)
+      return;
+    void *ptr = this->allocate(size);
+    if (!ptr)
+      return;
+    relocate(_heap.ptr, ptr);
+    destroy();
+    _heap = {ptr, size};
+  }
+  bool is_sbo() const noexcept { return !(_ops_and_flag & heap_bit); }
+  ~compact_sbo_base() noexcept { destroy(); }
+  template <std::size_t, typename, typename> friend class compact_sbo_base;
+};
+
 } // namespace sg
 
 #endif // UTILS_SBO_BASE_HPP
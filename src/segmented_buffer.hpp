@@ -0,0 +1,244 @@
+/*
+ * growable buffer that never relocates its elements. storage is a list of
+ * chunks whose size doubles, so indexing is a few bit operations and
+ * elements can be non-copyable and non-movable
+ */
+
+#ifndef UTILS_SEGMENTED_BUFFER_HPP
+#define UTILS_SEGMENTED_BUFFER_HPP
+
+#include <algorithm>
+#include <cassert>
+#include <climits>
+#include <cstddef>
+#include <iterator>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#include "fixed_buffer.hpp"
+#include "span.hpp"
+
+namespace utils {
+
+/**
+ * @brief unbounded buffer with stable addresses. chunk k holds
+ * ChunkSize << k elements, adding a chunk never moves the previous ones
+ * @tparam T type of the elements
+ * @tparam ChunkSize size of the first chunk, a power of 2
+ * @tparam Allocator same requirements as for fixed_buffer, chunks can
+ * come from an arena with arena_allocator
+ */
+template <typename T, std::size_t ChunkSize = 16,
+          typename Allocator = aligned_allocator>
+class segmented_buffer : private Allocator {
+  static_assert(ChunkSize > 0 && (ChunkSize & (ChunkSize - 1)) == 0,
+                "ChunkSize must be a power of 2");
+
+public:
+  using value_type = T;
+  using size_type = std::size_t;
+  using reference = value_type &;
+  using const_reference = const value_type &;
+  using allocator_type = Allocator;
+
+private:
+  static constexpr size_type log2(size_type value) noexcept {
+    return value == 1 ? 0 : 1 + log2(value >> 1);
+  }
+  static constexpr size_type chunk_shift = log2(ChunkSize);
+  static constexpr size_type bits = sizeof(size_type) * CHAR_BIT;
+
+public:
+  /// enough chunks for every index representable in size_type.
+  static constexpr size_type max_chunks = bits - chunk_shift;
+
+private:
+  T *_chunks[max_chunks] = {};
+  size_type _chunk_count = 0;
+  size_type _size = 0;
+
+  /// chunk holding index pos and the offset of pos in it.
+  static std::pair<size_type, size_type> locate(size_type pos) noexcept {
+    size_type scaled = (pos >> chunk_shift) + 1;
+    size_type chunk = bits - 1 - __builtin_clzll(scaled);
+    return {chunk, pos - chunk_begin(chunk)};
+  }
+  static size_type chunk_begin(size_type chunk) noexcept {
+    return ((size_type(1) << chunk) - 1) << chunk_shift;
+  }
+  size_type chunk_filled(size_type chunk) const noexcept {
+    size_type begin = chunk_begin(chunk);
+    return _size > begin ? std::min(_size - begin, chunk_size(chunk)) : 0;
+  }
+  void add_chunk() {
+    if (_chunk_count == max_chunks ||
+        chunk_size(_chunk_count) > fixed_buffer<T>::max_size())
+      throw std::length_error("segmented_buffer size too large");
+    void *ptr = this->allocate(sizeof(T) * chunk_size(_chunk_count),
+                               alignof(T));
+    if (!ptr)
+      throw std::bad_alloc();
+    _chunks[_chunk_count++] = static_cast<T *>(ptr);
+  }
+  void release() noexcept {
+    clear();
+    for (size_type chunk = 0; chunk < _chunk_count; chunk++)
+      this->deallocate(_chunks[chunk], sizeof(T) * chunk_size(chunk),
+                       alignof(T));
+    _chunk_count = 0;
+  }
+  std::string out_range_msg(size_type pos, const std::string &position) const {
+    return ("out of range : " + std::to_string(pos) +
+            " >= " + std::to_string(size()) + " in " + position);
+  }
+
+  template <bool is_const> class iterator_impl {
+    using buffer_type =
+        std::conditional_t<is_const, const segmented_buffer, segmented_buffer>;
+    buffer_type *_buffer = nullptr;
+    size_type _pos = 0;
+
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = T;
+    using difference_type = std::ptrdiff_t;
+    using pointer = std::conditional_t<is_const, const T, T> *;
+    using reference = std::conditional_t<is_const, const T, T> &;
+
+    iterator_impl() noexcept = default;
+    iterator_impl(buffer_type *buffer, size_type pos) noexcept
+        : _buffer{buffer}, _pos{pos} {}
+    reference operator*() const noexcept { return (*_buffer)[_pos]; }
+    pointer operator->() const noexcept { return &**this; }
+    iterator_impl &operator++() noexcept {
+      ++_pos;
+      return *this;
+    }
+    iterator_impl operator++(int) noexcept {
+      iterator_impl tmp = *this;
+      ++_pos;
+      return tmp;
+    }
+    bool operator==(const iterator_impl &other) const noexcept {
+      return _pos == other._pos;
+    }
+    bool operator!=(const iterator_impl &other) const noexcept {
+      return _pos != other._pos;
+    }
+  };
+
+public:
+  using iterator = iterator_impl<false>;
+  using const_iterator = iterator_impl<true>;
+
+  segmented_buffer() = default;
+  explicit segmented_buffer(const Allocator &alloc) : Allocator(alloc) {}
+  segmented_buffer(const segmented_buffer &) = delete;
+  segmented_buffer &operator=(const segmented_buffer &) = delete;
+  segmented_buffer(segmented_buffer &&other) noexcept
+      : Allocator(std::move(static_cast<Allocator &>(other))),
+        _chunk_count{std::exchange(other._chunk_count, 0)},
+        _size{std::exchange(other._size, 0)} {
+    std::copy(other._chunks, other._chunks + _chunk_count, _chunks);
+  }
+  segmented_buffer &operator=(segmented_buffer &&other) noexcept {
+    if (this != &other) {
+      release();
+      new (this) segmented_buffer(std::move(other));
+    }
+    return *this;
+  }
+  /// number of elements in chunk.
+  static constexpr size_type chunk_size(size_type chunk) noexcept {
+    return ChunkSize << chunk;
+  }
+  /**
+   * @brief construct an element at the end, a chunk twice as large as the
+   * last one is added if it is full
+   * @return reference on the new element
+   */
+  template <typename... Ts> reference emplace(Ts &&... ts) {
+    auto [chunk, offset] = locate(_size);
+    if (chunk == _chunk_count)
+      add_chunk();
+    T *ptr = new (_chunks[chunk] + offset) T(std::forward<Ts>(ts)...);
+    _size++;
+    return *ptr;
+  }
+  /// add chunks until there is room for capacity elements.
+  void reserve(size_type capacity) {
+    while (this->capacity() < capacity)
+      add_chunk();
+  }
+  void pop_back() noexcept {
+    assert(_size && "pop_back on an empty segmented_buffer");
+    (*this)[--_size].~T();
+  }
+  /// destroy the elements, the chunks are kept for the next elements.
+  void clear() noexcept {
+    if constexpr (!std::is_trivially_destructible_v<T>)
+      while (_size)
+        pop_back();
+    _size = 0;
+  }
+  reference operator[](size_type pos) noexcept {
+    auto [chunk, offset] = locate(pos);
+    return _chunks[chunk][offset];
+  }
+  const_reference operator[](size_type pos) const noexcept {
+    auto [chunk, offset] = locate(pos);
+    return _chunks[chunk][offset];
+  }
+  reference at(size_type pos) {
+    if (pos < size())
+      return (*this)[pos];
+    throw std::out_of_range(out_range_msg(pos, __PRETTY_FUNCTION__));
+  }
+  const_reference at(size_type pos) const {
+    if (pos < size())
+      return (*this)[pos];
+    throw std::out_of_range(out_range_msg(pos, __PRETTY_FUNCTION__));
+  }
+  /// number of chunks holding elements.
+  size_type chunk_count() const noexcept {
+    return _size ? locate(_size - 1).first + 1 : 0;
+  }
+  /// contiguous elements of chunk, the last chunk may be partially filled and
+  /// chunks past chunk_count() are empty.
+  sg::span<T> chunk(size_type chunk) noexcept {
+    return {_chunks[chunk], chunk_filled(chunk)};
+  }
+  sg::span<const T> chunk(size_type chunk) const noexcept {
+    return {_chunks[chunk], chunk_filled(chunk)};
+  }
+  /// call f on the span of every chunk holding elements, in order.
+  template <typename F> void for_each_chunk(F &&f) {
+    for (size_type idx = 0, count = chunk_count(); idx < count; idx++)
+      f(chunk(idx));
+  }
+  template <typename F> void for_each_chunk(F &&f) const {
+    for (size_type idx = 0, count = chunk_count(); idx < count; idx++)
+      f(chunk(idx));
+  }
+  iterator begin() noexcept { return {this, 0}; }
+  const_iterator begin() const noexcept { return {this, 0}; }
+  iterator end() noexcept { return {this, _size}; }
+  const_iterator end() const noexcept { return {this, _size}; }
+  reference front() noexcept { return (*this)[0]; }
+  const_reference front() const noexcept { return (*this)[0]; }
+  reference back() noexcept { return (*this)[_size - 1]; }
+  const_reference back() const noexcept { return (*this)[_size - 1]; }
+  size_type size() const noexcept { return _size; }
+  /// number of elements the allocated chunks can hold.
+  size_type capacity() const noexcept { return chunk_begin(_chunk_count); }
+  [[nodiscard]] bool empty() const noexcept { return _size == 0; }
+  const Allocator &get_allocator() const noexcept { return *this; }
+  ~segmented_buffer() { release(); }
+};
+
+} // namespace utils
+
+#endif // UTILS_SEGMENTED_BUFFER_HPP
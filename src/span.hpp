@@ -0,0 +1,79 @@
+/*
+ * minimal non-owning view on contiguous elements, like std::span with a
+ * dynamic extent
+ */
+
+#ifndef UTILS_SPAN_HPP
+#define UTILS_SPAN_HPP
+
+#include <cassert>
+#include <cstddef>
+#include <iterator>
+#include <type_traits>
+
+namespace sg {
+
+template <typename T> class span {
+  T *_data = nullptr;
+  std::size_t _size = 0;
+
+public:
+  using element_type = T;
+  using value_type = std::remove_cv_t<T>;
+  using iterator = T *;
+
+  constexpr span() noexcept = default;
+  constexpr span(T *data, std::size_t size) noexcept
+      : _data{data}, _size{size} {}
+  constexpr span(T *first, T *last) noexcept
+      : _data{first}, _size(last - first) {}
+  template <std::size_t N>
+  constexpr span(T (&array)[N]) noexcept : _data{array}, _size{N} {}
+  /// from a contiguous container, like std::vector.
+  template <typename C,
+            std::enable_if_t<
+                !std::is_same_v<std::decay_t<C>, span> &&
+                    std::is_convertible_v<
+                        decltype(std::data(std::declval<C &>())), T *>,
+                int> = 0>
+  constexpr span(C &&container) noexcept
+      : _data{std::data(container)}, _size{std::size(container)} {}
+  /// span<T> to span<const T>.
+  template <typename U,
+            std::enable_if_t<std::is_convertible_v<U (*)[], T (*)[]>, int> = 0>
+  constexpr span(span<U> other) noexcept
+      : _data{other.data()}, _size{other.size()} {}
+
+  constexpr T *data() const noexcept { return _data; }
+  constexpr std::size_t size() const noexcept { return _size; }
+  [[nodiscard]] constexpr bool empty() const noexcept { return _size == 0; }
+  constexpr T *begin() const noexcept { return _data; }
+  constexpr T *end() const noexcept { return _data + _size; }
+  constexpr T &operator[](std::size_t idx) const noexcept {
+    assert(idx < _size && "out of bounds");
+    return _data[idx];
+  }
+  constexpr span first(std::size_t count) const noexcept {
+    assert(count <= _size && "out of bounds");
+    return {_data, count};
+  }
+  constexpr span subspan(std::size_t offset) const noexcept {
+    assert(offset <= _size && "out of bounds");
+    return {_data + offset, _size - offset};
+  }
+  constexpr span subspan(std::size_t offset,
+                         std::size_t count) const noexcept {
+    assert(offset <= _size && count <= _size - offset && "out of bounds");
+    return {_data + offset, count};
+  }
+};
+
+template <typename T, std::size_t N> span(T (&)[N]) -> span<T>;
+
+template <typename C>
+span(C &) -> span<std::remove_pointer_t<decltype(std::data(
+    std::declval<C &>()))>>;
+
+} // namespace sg
+
+#endif // UTILS_SPAN_HPP
@@ -0,0 +1,340 @@
+/*
+ * lazy C++20 coroutine task. frames come from a thread-local recycling pool
+ * or from an arena installed with task_frame_arena, so starting and awaiting
+ * tasks doesn't allocate in steady state. requires C++20
+ */
+
+#ifndef UTILS_TASK_HPP
+#define UTILS_TASK_HPP
+
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+#include "any_callable.hpp"
+#include "any_callable_ref.hpp"
+
+namespace sg {
+
+template <typename T = void> class task;
+
+namespace detail {
+
+using task_frame_alloc = any_callable_ref<void *(std::size_t)>;
+
+/// arena of the innermost task_frame_arena of the thread.
+inline thread_local task_frame_alloc *current_task_arena = nullptr;
+
+enum class task_frame_origin : std::uint32_t { pool, heap, arena };
+
+/// placed before the frame, it keeps the frame aligned for any coroutine.
+struct alignas(std::max_align_t) task_frame_header {
+  task_frame_origin origin;
+};
+
+/**
+ * @brief free lists of frames by size class. a frame freed on another thread
+ * than the one that allocated it goes to the pool of the freeing thread
+ */
+class task_frame_pool {
+  static constexpr std::size_t granularity = 64;
+  static constexpr std::size_t class_count = 16;
+  /// blocks kept per class, the rest is given back to the heap.
+  static constexpr std::size_t max_cached = 64;
+  struct free_block {
+    free_block *next;
+  };
+  free_block *_free[class_count] = {};
+  std::size_t _cached[class_count] = {};
+
+  static std::size_t class_of(std::size_t size) noexcept {
+    return (size - 1) / granularity;
+  }
+
+public:
+  /// blocks bigger than this come from the heap.
+  static constexpr std::size_t max_size = granularity * class_count;
+
+  static task_frame_pool &local() {
+    static thread_local task_frame_pool pool;
+    return pool;
+  }
+  void *alloc(std::size_t size) {
+    std::size_t cls = class_of(size);
+    if (free_block *block = _free[cls]) {
+      _free[cls] = block->next;
+      _cached[cls]--;
+      return block;
+    }
+    return ::operator new((cls + 1) * granularity);
+  }
+  void free(void *ptr, std::size_t size) noexcept {
+    std::size_t cls = class_of(size);
+    if (_cached[cls] == max_cached) {
+      ::operator delete(ptr);
+      return;
+    }
+    _free[cls] = new (ptr) free_block{_free[cls]};
+    _cached[cls]++;
+  }
+  ~task_frame_pool() {
+    for (free_block *block : _free)
+      while (block)
+        ::operator delete(std::exchange(block, block->next));
+  }
+};
+
+inline void *alloc_task_frame(std::size_t size) {
+  size += sizeof(task_frame_header);
+  void *ptr;
+  task_frame_origin origin;
+  if (current_task_arena) {
+    ptr = (*current_task_arena)(size);
+    origin = task_frame_origin::arena;
+  } else if (size <= task_frame_pool::max_size) {
+    ptr = task_frame_pool::local().alloc(size);
+    origin = task_frame_origin::pool;
+  } else {
+    ptr = ::operator new(size);
+    origin = task_frame_origin::heap;
+  }
+  return new (ptr) task_frame_header{origin} + 1;
+}
+
+inline void free_task_frame(void *frame, std::size_t size) noexcept {
+  auto *header = static_cast<task_frame_header *>(frame) - 1;
+  size += sizeof(task_frame_header);
+  switch (header->origin) {
+  case task_frame_origin::pool:
+    task_frame_pool::local().free(header, size);
+    break;
+  case task_frame_origin::heap:
+    ::operator delete(header);
+    break;
+  case task_frame_origin::arena:
+    // released with the arena
+    break;
+  }
+}
+
+struct task_promise_base {
+  /// coroutine awaiting the task.
+  std::coroutine_handle<> continuation;
+  /// set by the first of the awaiter and the final suspend, the second one
+  /// resumes the continuation.
+  std::atomic<bool> handoff{false};
+  /// callback given to task::start, it is called if there is no continuation.
+  any_callable<void() &&, 3 * sizeof(void *)> on_done;
+  std::exception_ptr error;
+
+  /// only the sized form is declared so the frame size is passed back.
+  static void *operator new(std::size_t size) {
+    return alloc_task_frame(size);
+  }
+  static void operator delete(void *ptr, std::size_t size) noexcept {
+    free_task_frame(ptr, size);
+  }
+  struct final_awaiter {
+    bool await_ready() const noexcept { return false; }
+    template <typename Promise>
+    std::coroutine_handle<>
+    await_suspend(std::coroutine_handle<Promise> self) noexcept {
+      task_promise_base &promise = self.promise();
+      if (promise.continuation) {
+        if (promise.handoff.exchange(true, std::memory_order_acq_rel))
+          return promise.continuation;
+        // the awaiter hasn't suspended yet, it will continue inline
+        return std::noop_coroutine();
+      }
+      if (promise.on_done) {
+        // the callback may destroy the task and its frame
+        decltype(promise.on_done) done(std::move(promise.on_done));
+        std::move(done)();
+      }
+      return std::noop_coroutine();
+    }
+    void await_resume() const noexcept {}
+  };
+  std::suspend_always initial_suspend() const noexcept { return {}; }
+  final_awaiter final_suspend() const noexcept { return {}; }
+  void unhandled_exception() noexcept { error = std::current_exception(); }
+  void rethrow_if_failed() const {
+    if (error)
+      std::rethrow_exception(error);
+  }
+};
+
+template <typename T> struct task_promise : task_promise_base {
+  std::optional<T> value;
+  task<T> get_return_object() noexcept;
+  template <typename U = T,
+            std::enable_if_t<std::is_convertible_v<U &&, T>, int> = 0>
+  void return_value(U &&v) noexcept(std::is_nothrow_constructible_v<T, U>) {
+    value.emplace(std::forward<U>(v));
+  }
+  T result() {
+    rethrow_if_failed();
+    assert(value && "task didn't complete");
+    return std::move(*value);
+  }
+};
+
+template <> struct task_promise<void> : task_promise_base {
+  task<void> get_return_object() noexcept;
+  void return_void() const noexcept {}
+  void result() const { rethrow_if_failed(); }
+};
+
+} // namespace detail
+
+/**
+ * @brief make frames of the tasks created on this thread come from arena
+ * while the scope is alive. frames are never freed individually, so every
+ * task created in the scope must be destroyed before the memory of arena is
+ * reclaimed, for example before the matching PopFrame
+ * @tparam Arena allocator with Allocate(size, align), like
+ * llvm::StackedBumpAllocator
+ */
+template <typename Arena> class task_frame_arena {
+  struct allocate {
+    Arena &arena;
+    void *operator()(std::size_t size) {
+      return arena.Allocate(size, alignof(std::max_align_t));
+    }
+  } _allocate;
+  detail::task_frame_alloc _ref;
+  detail::task_frame_alloc *_prev;
+
+public:
+  explicit task_frame_arena(Arena &arena)
+      : _allocate{arena}, _ref{_allocate},
+        _prev{std::exchange(detail::current_task_arena, &_ref)} {}
+  task_frame_arena(const task_frame_arena &) = delete;
+  task_frame_arena &operator=(const task_frame_arena &) = delete;
+  ~task_frame_arena() {
+    assert(detail::current_task_arena == &_ref && "scopes must be nested");
+    detail::current_task_arena = _prev;
+  }
+};
+
+/**
+ * @brief lazy coroutine producing a T. the body starts when the task is
+ * awaited or started. a task that completes after suspending resumes its
+ * awaiter by symmetric transfer, one that completes synchronously returns to
+ * its awaiter without suspending it, so the stack doesn't grow in either case
+ */
+template <typename T> class task {
+public:
+  using promise_type = detail::task_promise<T>;
+  using handle_type = std::coroutine_handle<promise_type>;
+
+private:
+  handle_type _handle;
+
+  explicit task(handle_type handle) noexcept : _handle{handle} {}
+  friend promise_type;
+
+  struct awaiter {
+    handle_type handle;
+    bool await_ready() const noexcept { return handle.done(); }
+    bool await_suspend(std::coroutine_handle<> awaiting) {
+      handle.promise().continuation = awaiting;
+      handle.resume();
+      // don't suspend if the task already completed, so awaiting tasks that
+      // complete synchronously doesn't grow the stack even when the compiler
+      // doesn't turn symmetric transfer into a tail call
+      return !handle.promise().handoff.exchange(true,
+                                                std::memory_order_acq_rel);
+    }
+    T await_resume() { return handle.promise().result(); }
+  };
+
+public:
+  task() noexcept = default;
+  task(task &&other) noexcept : _handle{std::exchange(other._handle, {})} {}
+  task &operator=(task &&other) noexcept {
+    if (this != &other) {
+      if (_handle)
+        _handle.destroy();
+      _handle = std::exchange(other._handle, {});
+    }
+    return *this;
+  }
+  task(const task &) = delete;
+  task &operator=(const task &) = delete;
+  awaiter operator co_await() const noexcept {
+    assert(_handle && "awaiting an empty task");
+    return awaiter{_handle};
+  }
+  /**
+   * @brief run the task until its first suspension point. on_done is called
+   * once the task completes, possibly before start returns. the task must be
+   * kept alive until then, the callback may destroy it
+   */
+  template <typename F> void start(F &&on_done) {
+    assert(_handle && !_handle.done() && "task can't be started");
+    _handle.promise().on_done = std::forward<F>(on_done);
+    _handle.resume();
+  }
+  void start() {
+    assert(_handle && !_handle.done() && "task can't be started");
+    _handle.resume();
+  }
+  [[nodiscard]] bool done() const noexcept { return _handle.done(); }
+  /// value returned by the task, rethrow the exception it exited with.
+  T result() {
+    assert(done() && "task isn't done");
+    return _handle.promise().result();
+  }
+  [[nodiscard]] explicit operator bool() const noexcept {
+    return bool(_handle);
+  }
+  ~task() {
+    if (_handle)
+      _handle.destroy();
+  }
+};
+
+template <typename T>
+task<T> detail::task_promise<T>::get_return_object() noexcept {
+  return task<T>{std::coroutine_handle<task_promise>::from_promise(*this)};
+}
+
+inline task<void> detail::task_promise<void>::get_return_object() noexcept {
+  return task<void>{std::coroutine_handle<task_promise>::from_promise(*this)};
+}
+
+/**
+ * @brief start t and block until it completes, it can be resumed from another
+ * thread
+ * @return the result of t
+ */
+template <typename T> T sync_wait(task<T> &t) {
+  std::mutex lock;
+  std::condition_variable cond;
+  bool finished = false;
+  t.start([&] {
+    // notify under the lock, the waiter may return as soon as it is released
+    std::lock_guard<std::mutex> guard(lock);
+    finished = true;
+    cond.notify_one();
+  });
+  std::unique_lock<std::mutex> guard(lock);
+  cond.wait(guard, [&] { return finished; });
+  return t.result();
+}
+
+template <typename T> T sync_wait(task<T> &&t) { return sync_wait(t); }
+
+} // namespace sg
+
+#endif // UTILS_TASK_HPP
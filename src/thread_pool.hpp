@@ -0,0 +1,400 @@
+/*
+ * work-stealing thread pool whose tasks are any_callable stored inline in
+ * per-worker Chase-Lev deques
+ */
+
+#ifndef UTILS_THREAD_POOL_HPP
+#define UTILS_THREAD_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "any_callable.hpp"
+#include "mpsc_queue.hpp"
+
+namespace sg {
+
+namespace detail {
+
+/**
+ * @brief Chase-Lev deque with tasks stored inline. the owner pushes and pops
+ * at the bottom, thieves steal at the top. a thief claims a slot before
+ * reading it and releases it once the task has been moved out, so the owner
+ * never overwrites a slot that is being read
+ */
+template <std::size_t sbo_size> class work_deque {
+public:
+  using task_type = any_callable<void() &&, sbo_size>;
+
+private:
+  struct alignas(cache_line_size) slot {
+    std::atomic<bool> full{false};
+    task_type task;
+  };
+  std::unique_ptr<slot[]> _slots;
+  std::int64_t _mask;
+  alignas(cache_line_size) std::atomic<std::int64_t> _top{0};
+  alignas(cache_line_size) std::atomic<std::int64_t> _bottom{0};
+
+  void take(slot &s, task_type &out) noexcept {
+    out = std::move(s.task);
+    s.full.store(false, std::memory_order_release);
+  }
+
+public:
+  /// capacity must be a power of 2.
+  explicit work_deque(std::size_t capacity)
+      : _slots{new slot[capacity]}, _mask(capacity - 1) {}
+  /// owner only, return false if the deque is full.
+  template <typename F> bool push(F &&f) {
+    std::int64_t b = _bottom.load(std::memory_order_relaxed);
+    std::int64_t t = _top.load(std::memory_order_acquire);
+    if (b - t > _mask)
+      return false;
+    slot &s = _slots[b & _mask];
+    if (s.full.load(std::memory_order_acquire))
+      return false;
+    s.task = std::forward<F>(f);
+    s.full.store(true, std::memory_order_relaxed);
+    _bottom.store(b + 1, std::memory_order_release);
+    return true;
+  }
+  /// owner only, take the most recently pushed task.
+  bool pop(task_type &out) noexcept {
+    std::int64_t b = _bottom.load(std::memory_order_relaxed) - 1;
+    _bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    std::int64_t t = _top.load(std::memory_order_relaxed);
+    if (t > b) {
+      _bottom.store(b + 1, std::memory_order_relaxed);
+      return false;
+    }
+    if (t == b) {
+      bool won = _top.compare_exchange_strong(
+          t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+      _bottom.store(b + 1, std::memory_order_relaxed);
+      if (!won)
+        return false;
+    }
+    take(_slots[b & _mask], out);
+    return true;
+  }
+  /// any thread, take the oldest task.
+  bool steal(task_type &out) noexcept {
+    std::int64_t t = _top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    std::int64_t b = _bottom.load(std::memory_order_acquire);
+    if (t >= b)
+      return false;
+    if (!_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                      std::memory_order_relaxed))
+      return false;
+    take(_slots[t & _mask], out);
+    return true;
+  }
+};
+
+struct no_scratch {};
+
+} // namespace detail
+
+/// counter of the unfinished tasks spawned in it, see thread_pool::wait.
+class task_group {
+  std::atomic<std::size_t> _count{0};
+  std::atomic<bool> _failed{false};
+  std::exception_ptr _error;
+  template <std::size_t, typename> friend class thread_pool;
+
+public:
+  task_group() = default;
+  task_group(const task_group &) = delete;
+  task_group &operator=(const task_group &) = delete;
+  [[nodiscard]] bool done() const noexcept {
+    return _count.load(std::memory_order_acquire) == 0;
+  }
+};
+
+/**
+ * @brief work-stealing thread pool. tasks spawned from a worker go to its own
+ * deque, other threads go through a shared queue. idle workers steal from a
+ * random victim
+ * @tparam sbo_size size of the sbo of the tasks
+ * @tparam Scratch optional allocator owned by each worker, like
+ * llvm::StackedBumpAllocator. a frame is pushed before every task and popped
+ * after it so tasks can get scratch memory from thread_pool::scratch()
+ */
+template <std::size_t sbo_size = 32, typename Scratch = void>
+class thread_pool {
+public:
+  using task_type = any_callable<void() &&, sbo_size>;
+  static constexpr bool has_scratch = !std::is_void_v<Scratch>;
+
+private:
+  using scratch_type =
+      std::conditional_t<has_scratch, Scratch, detail::no_scratch>;
+  struct worker {
+    detail::work_deque<sbo_size> deque;
+    scratch_type scratch;
+    std::minstd_rand rng;
+    std::thread thread;
+    worker(std::size_t capacity, unsigned seed)
+        : deque{capacity}, rng{seed} {}
+  };
+  std::vector<std::unique_ptr<worker>> _workers;
+  std::mutex _lock;
+  std::condition_variable _wake;
+  std::deque<task_type> _injected;
+  std::atomic<std::size_t> _injected_count{0};
+  /// number of tasks pushed but not yet taken.
+  std::atomic<std::size_t> _pending{0};
+  std::atomic<std::size_t> _sleeping{0};
+  std::atomic<bool> _stop{false};
+  static inline thread_local worker *_current = nullptr;
+  static inline thread_local thread_pool *_current_pool = nullptr;
+
+  worker *current() const noexcept {
+    return _current_pool == this ? _current : nullptr;
+  }
+  void notify() {
+    if (_sleeping.load(std::memory_order_seq_cst)) {
+      std::lock_guard<std::mutex> guard(_lock);
+      _wake.notify_one();
+    }
+  }
+  template <typename F> void push(F &&f) {
+    // the task is built before it is counted, so a throwing move or
+    // allocation doesn't leave _pending raised
+    task_type task(std::forward<F>(f));
+    worker *self = current();
+    _pending.fetch_add(1, std::memory_order_seq_cst);
+    if (!self || !self->deque.push(std::move(task))) {
+      if (self) {
+        // the deque is full, running the task now keeps the depth-first
+        // order of fork/join code
+        _pending.fetch_sub(1, std::memory_order_relaxed);
+        run(self, task);
+        return;
+      }
+      try {
+        std::lock_guard<std::mutex> guard(_lock);
+        _injected.emplace_back(std::move(task));
+        _injected_count.fetch_add(1, std::memory_order_release);
+      } catch (...) {
+        _pending.fetch_sub(1, std::memory_order_relaxed);
+        throw;
+      }
+    }
+    notify();
+  }
+  bool take_injected(task_type &out) {
+    if (!_injected_count.load(std::memory_order_acquire))
+      return false;
+    std::lock_guard<std::mutex> guard(_lock);
+    if (_injected.empty())
+      return false;
+    out = std::move(_injected.front());
+    _injected.pop_front();
+    _injected_count.fetch_sub(1, std::memory_order_relaxed);
+    return true;
+  }
+  bool steal(worker *self, task_type &out) {
+    std::size_t count = _workers.size();
+    std::size_t start = self->rng() % count;
+    for (std::size_t idx = 0; idx < count; idx++) {
+      worker *victim = _workers[(start + idx) % count].get();
+      if (victim != self && victim->deque.steal(out))
+        return true;
+    }
+    return false;
+  }
+  bool take(worker *self, task_type &out) {
+    bool found =
+        self->deque.pop(out) || take_injected(out) || steal(self, out);
+    if (found)
+      _pending.fetch_sub(1, std::memory_order_relaxed);
+    return found;
+  }
+  struct scratch_frame {
+    worker *self;
+    explicit scratch_frame(worker *w) : self{w} {
+      if constexpr (has_scratch)
+        if (self)
+          self->scratch.PushFrame();
+    }
+    ~scratch_frame() {
+      if constexpr (has_scratch)
+        if (self)
+          self->scratch.PopFrame();
+    }
+  };
+  static void run(worker *self, task_type &task) {
+    scratch_frame frame{self};
+    std::move(task)();
+  }
+  void worker_loop(worker *self) {
+    _current = self;
+    _current_pool = this;
+    task_type task;
+    while (true) {
+      if (take(self, task)) {
+        run(self, task);
+        continue;
+      }
+      std::unique_lock<std::mutex> guard(_lock);
+      _sleeping.fetch_add(1, std::memory_order_seq_cst);
+      _wake.wait(guard, [&] {
+        return _pending.load(std::memory_order_seq_cst) ||
+               _stop.load(std::memory_order_relaxed);
+      });
+      _sleeping.fetch_sub(1, std::memory_order_relaxed);
+      if (_stop.load(std::memory_order_relaxed) &&
+          !_pending.load(std::memory_order_relaxed))
+        break;
+    }
+    _current = nullptr;
+    _current_pool = nullptr;
+  }
+
+public:
+  /**
+   * @param thread_count number of workers
+   * @param deque_capacity number of tasks each worker can hold, must be a
+   * power of 2
+   */
+  explicit thread_pool(
+      std::size_t thread_count = std::thread::hardware_concurrency(),
+      std::size_t deque_capacity = 1024) {
+    thread_count = thread_count ? thread_count : 1;
+    for (std::size_t idx = 0; idx < thread_count; idx++)
+      _workers.push_back(
+          std::make_unique<worker>(deque_capacity, unsigned(idx + 1)));
+    for (auto &w : _workers)
+      w->thread = std::thread([this, self = w.get()] { worker_loop(self); });
+  }
+  thread_pool(const thread_pool &) = delete;
+  thread_pool &operator=(const thread_pool &) = delete;
+  /// run f on a worker without tracking its completion. nothing can report
+  /// an exception from f so it must not throw, std::terminate is called
+  /// otherwise.
+  template <typename F> void spawn(F &&f) { push(std::forward<F>(f)); }
+  /**
+   * @brief run f on a worker, wait(group) returns once it has run. the first
+   * exception thrown by a task of the group is rethrown by wait
+   */
+  template <typename F> void spawn(task_group &group, F &&f) {
+    // counted before the push since the task may finish before it returns,
+    // and uncounted if the task can't be built or queued
+    group._count.fetch_add(1, std::memory_order_relaxed);
+    try {
+      push([&group, f = std::forward<F>(f)]() mutable {
+        struct finish {
+          task_group &group;
+          ~finish() { group._count.fetch_sub(1, std::memory_order_release); }
+        } guard{group};
+        try {
+          std::move(f)();
+        } catch (...) {
+          if (!group._failed.exchange(true))
+            group._error = std::current_exception();
+        }
+      });
+    } catch (...) {
+      group._count.fetch_sub(1, std::memory_order_release);
+      throw;
+    }
+  }
+  /**
+   * @brief return once every task of group has finished. a worker runs other
+   * tasks while it waits, other threads only yield so that tasks always run
+   * on a worker
+   */
+  void wait(task_group &group) {
+    worker *self = current();
+    task_type task;
+    while (!group.done()) {
+      if (self && take(self, task))
+        run(self, task);
+      else
+        std::this_thread::yield();
+    }
+    if (group._failed.load(std::memory_order_acquire)) {
+      group._failed.store(false, std::memory_order_relaxed);
+      std::rethrow_exception(std::exchange(group._error, nullptr));
+    }
+  }
+  /**
+   * @brief call f(i) for each i in [begin, end). the range is split in halves
+   * down to chunks of grain elements. if f throws, the tasks already spawned
+   * are waited for and the first exception is rethrown
+   */
+  template <typename F>
+  void parallel_for(std::size_t begin, std::size_t end, std::size_t grain,
+                    F &&f) {
+    struct context {
+      thread_pool &pool;
+      task_group group;
+      std::size_t grain;
+      F &f;
+      void split(std::size_t first, std::size_t last) {
+        while (last - first > grain) {
+          std::size_t mid = first + (last - first) / 2;
+          pool.spawn(group, [this, mid, last] { split(mid, last); });
+          last = mid;
+        }
+        for (; first < last; first++)
+          f(first);
+      }
+    } ctx{*this, {}, grain ? grain : 1, f};
+    // the spawned tasks reference ctx, so they must finish before it is
+    // destroyed even if the part run on this thread throws
+    std::exception_ptr error;
+    if (begin < end) {
+      try {
+        ctx.split(begin, end);
+      } catch (...) {
+        error = std::current_exception();
+      }
+    }
+    try {
+      wait(ctx.group);
+    } catch (...) {
+      if (!error)
+        error = std::current_exception();
+    }
+    if (error)
+      std::rethrow_exception(error);
+  }
+  /// scratch allocator of the current worker or nullptr outside of workers.
+  template <bool enable = has_scratch,
+            std::enable_if_t<enable, int> = 0>
+  [[nodiscard]] Scratch *scratch() noexcept {
+    worker *self = current();
+    return self ? &self->scratch : nullptr;
+  }
+  [[nodiscard]] std::size_t size() const noexcept { return _workers.size(); }
+  /// wait for every pending task then stop the workers.
+  ~thread_pool() {
+    {
+      std::lock_guard<std::mutex> guard(_lock);
+      _stop.store(true, std::memory_order_relaxed);
+      _wake.notify_all();
+    }
+    for (auto &w : _workers)
+      w->thread.join();
+  }
+};
+
+} // namespace sg
+
+#endif // UTILS_THREAD_POOL_HPP
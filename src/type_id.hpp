@@ -0,0 +1,67 @@
+/*
+ * per-type identifier that doesn't rely on rtti. comparing two identifiers is
+ * a single pointer compare
+ */
+
+#ifndef UTILS_TYPE_ID_HPP
+#define UTILS_TYPE_ID_HPP
+
+#include <atomic>
+#include <cstddef>
+
+namespace sg {
+
+using type_id_t = const void *;
+
+namespace detail {
+
+/// what a type_id points to. the index is given on first use so that it
+/// costs nothing to types that are never indexed.
+struct type_record {
+  static constexpr std::size_t no_index = std::size_t(-1);
+  mutable std::atomic<std::size_t> index{no_index};
+};
+
+template <typename T> struct type_tag { static inline type_record id{}; };
+
+inline std::size_t next_type_index() noexcept {
+  static std::atomic<std::size_t> next{0};
+  return next.fetch_add(1, std::memory_order_relaxed);
+}
+
+} // namespace detail
+
+/**
+ * @brief return an identifier unique to T. the identifier is the address of
+ * a per-type static so it can be used in constant expressions
+ * @tparam T type to identify
+ */
+template <typename T> constexpr type_id_t type_id() noexcept {
+  return &detail::type_tag<T>::id;
+}
+
+/**
+ * @brief return a small integer unique to the type identified by id, types
+ * get consecutive indexes in the order they are first asked for. unlike a
+ * type_id it is only known at run time but it can index a table
+ */
+inline std::size_t type_index(type_id_t id) noexcept {
+  const auto &record = *static_cast<const detail::type_record *>(id);
+  std::size_t index = record.index.load(std::memory_order_relaxed);
+  if (index != detail::type_record::no_index)
+    return index;
+  // a thread losing the race leaves a gap in the indexes
+  std::size_t next = detail::next_type_index();
+  if (record.index.compare_exchange_strong(index, next,
+                                           std::memory_order_relaxed))
+    return next;
+  return index;
+}
+
+template <typename T> std::size_t type_index() noexcept {
+  return type_index(type_id<T>());
+}
+
+} // namespace sg
+
+#endif // UTILS_TYPE_ID_HPP
@@ -3,7 +3,9 @@
  */
 
 #include "src/any_callable_ref.hpp"
+#include <algorithm>
 #include <gtest/gtest.h>
+#include <vector>
 
 namespace {
 
@@ -17,6 +19,22 @@ int global = 0;
 
 void free_func() { global++; }
 
+int scaled(const int &scale, int a) { return scale * a; }
+
+struct counter {
+  int value = 0;
+  int add(int a) { return value += a; }
+  int get() const { return value; }
+};
+
+struct greater {
+  int *calls;
+  bool operator()(int a, int b) const {
+    ++*calls;
+    return a > b;
+  }
+};
+
 } // namespace
 
 TEST(callable_ref, call_stateless_lambda_int) {
@@ -162,3 +180,106 @@ TEST(callable_ref, copy_call_statefull_copy_lambda_string) {
   sg::any_callable_ref<std::string()> cop(ref);
   ASSERT_EQ(ref(), "a");
 }
+
+TEST(callable_ref, func_ptr_stored_by_value) {
+  sg::any_callable_ref<int(int)> ref;
+  {
+    int (*temporary)(int) = &free_add1;
+    ref = temporary;
+  }
+  ASSERT_EQ(ref(1), 2);
+  ASSERT_TRUE(ref == sg::any_callable_ref<int(int)>(&free_add1));
+  ASSERT_TRUE(ref == &free_add1);
+}
+
+TEST(callable_ref, bind_free_function) {
+  auto ref = sg::any_callable_ref<int(int)>::bind<&free_add1>();
+  ASSERT_EQ(ref(1), 2);
+  ASSERT_EQ(ref, sg::any_callable_ref<int(int)>::bind<&free_add1>());
+  ASSERT_NE(ref, sg::any_callable_ref<int(int)>(&free_add1));
+  auto str_ref =
+      sg::any_callable_ref<std::string(const std::string &)>::bind<
+          &free_add_a>();
+  ASSERT_EQ(str_ref("b"), "ba");
+}
+
+TEST(callable_ref, bind_member_function) {
+  counter c;
+  auto add = sg::any_callable_ref<int(int)>::bind<&counter::add>(c);
+  ASSERT_EQ(add(2), 2);
+  ASSERT_EQ(add(3), 5);
+  const counter &cc = c;
+  auto get = sg::any_callable_ref<int()>::bind<&counter::get>(cc);
+  ASSERT_EQ(get(), 5);
+  auto value = sg::any_callable_ref<int()>::bind<&counter::value>(cc);
+  ASSERT_EQ(value(), 5);
+  counter other;
+  ASSERT_NE(add, sg::any_callable_ref<int(int)>::bind<&counter::add>(other));
+}
+
+TEST(callable_ref, bind_first_argument) {
+  int scale = 3;
+  auto ref = sg::any_callable_ref<int(int)>::bind<&scaled>(scale);
+  ASSERT_EQ(ref(2), 6);
+  scale = 4;
+  ASSERT_EQ(ref(2), 8);
+}
+
+TEST(callable_ref, const_callable) {
+  const auto pinned_callback = [](int i) { return i * 2; };
+  sg::any_callable_ref<int(int)> ref(pinned_callback);
+  ASSERT_EQ(ref(2), 4);
+}
+
+TEST(callable_ref, target) {
+  int calls = 0;
+  greater cmp{&calls};
+  sg::any_callable_ref<bool(int, int)> ref(cmp);
+  ASSERT_EQ(ref.target<greater>(), &cmp);
+  ASSERT_EQ(ref.target<const greater>(), &cmp);
+  ASSERT_EQ(ref.target<counter>(), nullptr);
+  const greater &const_cmp = cmp;
+  sg::any_callable_ref<bool(int, int)> const_ref(const_cmp);
+  ASSERT_EQ(const_ref.target<greater>(), nullptr);
+  ASSERT_EQ(const_ref.target<const greater>(), &cmp);
+  sg::any_callable_ref<int(int)> fn(&free_add1);
+  ASSERT_EQ(fn.target<int (*)(int)>(), nullptr);
+}
+
+TEST(callable_ref, with_known) {
+  int calls = 0;
+  greater cmp{&calls};
+  std::vector<int> values{3, 1, 4, 1, 5, 9, 2, 6};
+  auto sort = [&](auto &&comp) {
+    std::sort(values.begin(), values.end(), comp);
+    return std::is_same_v<std::decay_t<decltype(comp)>, greater>;
+  };
+  sg::any_callable_ref<bool(int, int)> ref(cmp);
+  ASSERT_TRUE(sg::with_known<greater>(ref, sort));
+  ASSERT_TRUE(std::is_sorted(values.begin(), values.end(), cmp));
+  ASSERT_GT(calls, 0);
+  auto less = [](int a, int b) { return a < b; };
+  sg::any_callable_ref<bool(int, int)> other(less);
+  ASSERT_FALSE(sg::with_known<greater>(other, sort));
+  ASSERT_TRUE(std::is_sorted(values.begin(), values.end()));
+}
+
+TEST(callable_ref, for_each_span) {
+  std::vector<int> values(1000);
+  for (int i = 0; i < 1000; i++)
+    values[i] = i;
+  long sum = 0;
+  int batches = 0;
+  auto add = [&](sg::span<const int> batch) {
+    batches++;
+    for (int v : batch)
+      sum += v;
+  };
+  sg::any_callable_ref<void(sg::span<const int>)> ref(add);
+  sg::for_each_span<const int>(values, ref, 128);
+  ASSERT_EQ(sum, 999L * 1000 / 2);
+  ASSERT_EQ(batches, 8);
+  batches = 0;
+  sg::for_each_span(sg::span<const int>{}, ref);
+  ASSERT_EQ(batches, 0);
+}
@@ -3,7 +3,9 @@
  */
 
 #include "src/any_callable.hpp"
+#include <array>
 #include <gtest/gtest.h>
+#include <memory>
 
 namespace {
 
@@ -350,11 +352,251 @@ TEST(callable, type_traits) {
                 any_callable<std::string(std::string)>>);
   static_assert(
       std::is_same_v<int, std::decay_t<decltype(
-                              std::declval<const any_callable<int()>>()())>>);
+                              std::declval<any_callable<int()> &>()())>>);
+  static_assert(std::is_same_v<
+                int, std::decay_t<decltype(
+                         std::declval<const any_callable<int() const>>()())>>);
   static_assert(
       std::is_same_v<
           std::string,
           std::decay_t<decltype(
-              std::declval<const any_callable<std::string(std::string)>>()(
+              std::declval<
+                  const any_callable<std::string(std::string) const>>()(
                   std::declval<std::string>()))>>);
-}
\ No newline at end of file
+  static_assert(!std::is_invocable_v<const any_callable<int()>>);
+  static_assert(!std::is_invocable_v<any_callable<int() &&> &>);
+  static_assert(std::is_invocable_v<any_callable<int() &&>>);
+  static_assert(std::is_nothrow_invocable_v<any_callable<int() noexcept> &>);
+  static_assert(!std::is_nothrow_invocable_v<any_callable<int()> &>);
+}
+TEST(callable, overloads_call) {
+  std::string log;
+  any_callable<sg::overloads<void(int), void(const std::string &)>> visitor(
+      [&](const auto &v) {
+        if constexpr (std::is_same_v<std::decay_t<decltype(v)>, int>)
+          log += std::to_string(v);
+        else
+          log += v;
+      });
+  visitor(1);
+  visitor(std::string("a"));
+  visitor(2);
+  ASSERT_EQ(log, "1a2");
+}
+
+TEST(callable, overloads_return_types) {
+  struct visitor {
+    int operator()(int i) const { return i + 1; }
+    std::string operator()(std::string s) const { return s + 'a'; }
+  };
+  any_callable<sg::overloads<int(int), std::string(std::string)>> v{
+      visitor{}};
+  ASSERT_EQ(v(1), 2);
+  ASSERT_EQ(v(std::string("b")), "ba");
+}
+
+TEST(callable, overloads_move_non_sbo) {
+  std::string state = "state";
+  any_callable<sg::overloads<std::string(int), std::string(std::string)>> v(
+      [state](auto a) {
+        if constexpr (std::is_same_v<decltype(a), int>)
+          return state + std::to_string(a);
+        else
+          return state + a;
+      });
+  any_callable<sg::overloads<std::string(int), std::string(std::string)>> cop(
+      std::move(v));
+  ASSERT_EQ(v.is_empty(), true);
+  ASSERT_EQ(cop(1), "state1");
+  ASSERT_EQ(cop(std::string("a")), "statea");
+}
+
+TEST(callable, overloads_single_storage) {
+  static_assert(sizeof(any_callable<sg::overloads<void(int), void(float),
+                                                  void(std::string)>>) ==
+                sizeof(any_callable<void(int)>));
+}
+
+TEST(callable, const_call) {
+  int i = 1;
+  const any_callable<int(int) const> add([i](int a) { return a + i; });
+  ASSERT_EQ(add(1), 2);
+}
+
+TEST(callable, noexcept_call) {
+  any_callable<int(int) noexcept> add([](int a) noexcept { return a + 1; });
+  static_assert(noexcept(add(1)));
+  ASSERT_EQ(add(1), 2);
+  any_callable<int(int) const noexcept> cadd(
+      [](int a) noexcept { return a + 2; });
+  ASSERT_EQ(cadd(1), 3);
+}
+
+TEST(callable, rvalue_call_consumes) {
+  auto counter = std::make_shared<int>(0);
+  any_callable<int() &&> once([counter] { return ++*counter; });
+  ASSERT_EQ(counter.use_count(), 2);
+  ASSERT_EQ(std::move(once)(), 1);
+  ASSERT_EQ(once.is_empty(), true);
+  ASSERT_EQ(counter.use_count(), 1);
+}
+
+TEST(callable, rvalue_call_consumes_non_sbo) {
+  std::string str = "a string that doesn't fit in the sbo";
+  any_callable<std::string() &&> once(
+      [str]() mutable { return std::move(str); });
+  ASSERT_EQ(any_callable<void()>::fit_sbo<decltype(str)>, false);
+  ASSERT_EQ(std::move(once)(), str);
+  ASSERT_EQ(once.is_empty(), true);
+  once = [] { return std::string("b"); };
+  ASSERT_EQ(std::move(once)(), "b");
+}
+
+TEST(callable, rvalue_call_throw_consumes) {
+  auto counter = std::make_shared<int>(0);
+  any_callable<void() &&> once([counter] { throw 1; });
+  ASSERT_THROW(std::move(once)(), int);
+  ASSERT_EQ(once.is_empty(), true);
+  ASSERT_EQ(counter.use_count(), 1);
+}
+
+TEST(callable, target) {
+  auto lambda1 = [](int a) { return a + 1; };
+  auto lambda2 = [](int a) { return a + 2; };
+  any_callable<int(int)> a(lambda1);
+  ASSERT_NE(a.target<decltype(lambda1)>(), nullptr);
+  ASSERT_EQ(a.target<decltype(lambda2)>(), nullptr);
+  ASSERT_EQ((*a.target<decltype(lambda1)>())(1), 2);
+  ASSERT_EQ(a.target_type(), sg::type_id<decltype(lambda1)>());
+  any_callable<int(int)> b;
+  ASSERT_EQ(b.target_type(), sg::type_id<void>());
+  ASSERT_EQ(b.target<decltype(lambda1)>(), nullptr);
+}
+
+TEST(callable, invoke_as) {
+  int calls = 0;
+  auto lambda1 = [&](int a) {
+    calls++;
+    return a + 1;
+  };
+  auto lambda2 = [](int a) { return a + 2; };
+  any_callable<int(int)> a(lambda1);
+  ASSERT_EQ(a.invoke_as<decltype(lambda1)>(1), 2);
+  ASSERT_EQ(a.invoke_as<decltype(lambda2)>(1), 2);
+  ASSERT_EQ(calls, 2);
+}
+
+TEST(callable, invoke_as_rvalue) {
+  struct once_fn {
+    std::shared_ptr<int> counter;
+    int operator()(int a) && { return a + ++*counter; }
+  };
+  auto counter = std::make_shared<int>(0);
+  any_callable<int(int) &&> f(once_fn{counter});
+  ASSERT_EQ(std::move(f).invoke_as<once_fn>(1), 2);
+  ASSERT_EQ(f.is_empty(), true);
+  ASSERT_EQ(counter.use_count(), 1);
+  f = [](int a) { return a + 10; };
+  ASSERT_EQ(std::move(f).invoke_as<once_fn>(1), 11);
+  ASSERT_EQ(f.is_empty(), true);
+
+  // the target is consumed on both paths with a signature that isn't &&
+  auto hit = [counter](int a) { return a + 1; };
+  auto miss = [counter](int a) { return a + 2; };
+  any_callable<int(int)> g(hit);
+  ASSERT_EQ(counter.use_count(), 4);
+  ASSERT_EQ(std::move(g).invoke_as<decltype(hit)>(1), 2);
+  ASSERT_EQ(g.is_empty(), true);
+  ASSERT_EQ(counter.use_count(), 3);
+  g = miss;
+  ASSERT_EQ(counter.use_count(), 4);
+  ASSERT_EQ(std::move(g).invoke_as<decltype(hit)>(1), 3);
+  ASSERT_EQ(g.is_empty(), true);
+  ASSERT_EQ(counter.use_count(), 3);
+}
+
+TEST(callable, visit) {
+  auto lambda1 = [](int a) { return a + 1; };
+  auto lambda2 = [](int a) { return a + 2; };
+  any_callable<int(int)> a(lambda2);
+  int matched = -1;
+  int res = a.visit<decltype(lambda1), decltype(lambda2)>([&](auto &target) {
+    using type = std::decay_t<decltype(target)>;
+    matched = std::is_same_v<type, decltype(lambda1)>   ? 1
+              : std::is_same_v<type, decltype(lambda2)> ? 2
+                                                        : 0;
+    int sum = 0;
+    for (int i = 0; i < 4; i++)
+      sum += target(i);
+    return sum;
+  });
+  ASSERT_EQ(matched, 2);
+  ASSERT_EQ(res, 14);
+  a = lambda1;
+  res = a.visit<decltype(lambda2)>([&](auto &target) { return target(0); });
+  ASSERT_EQ(res, 1);
+}
+
+TEST(callable, reassign_reuses_heap_block) {
+  auto make = [](long v) {
+    std::array<long, 8> values{};
+    values[7] = v;
+    return [values] { return values[7]; };
+  };
+  using big = decltype(make(0));
+  any_callable<long()> f(make(4));
+  ASSERT_EQ(f.capacity(), sizeof(big));
+  big *block = f.target<big>();
+  f = make(5);
+  ASSERT_EQ(f.target<big>(), block);
+  ASSERT_EQ(f(), 5);
+  // a smaller heap target reuses the block too
+  std::array<long, 4> medium{};
+  medium[3] = 6;
+  f = [medium] { return medium[3]; };
+  ASSERT_EQ(f.capacity(), sizeof(big));
+  ASSERT_EQ(f(), 6);
+  f.shrink_to_fit();
+  ASSERT_EQ(f.capacity(), sizeof(medium));
+  ASSERT_EQ(f(), 6);
+  // a target in the sbo releases the block
+  f = [] { return 7L; };
+  ASSERT_EQ(f.capacity(), 8u);
+}
+
+TEST(callable, consumed_keeps_heap_block) {
+  auto make = [](long v) {
+    std::array<long, 8> values{};
+    values[7] = v;
+    return [values] { return values[7]; };
+  };
+  using big = decltype(make(0));
+  any_callable<long() &&> f(make(1));
+  big *block = f.target<big>();
+  ASSERT_EQ(std::move(f)(), 1);
+  ASSERT_TRUE(f.is_empty());
+  ASSERT_EQ(f.capacity(), sizeof(big));
+  f = make(2);
+  ASSERT_EQ(f.target<big>(), block);
+  ASSERT_EQ(std::move(f)(), 2);
+  f.shrink_to_fit();
+  ASSERT_EQ(f.capacity(), 8u);
+}
+
+TEST(callable, compact_layout) {
+  static_assert(sizeof(sg::any_callable<void(), 24>) == 32);
+  static_assert(sizeof(sg::any_callable<sg::overloads<int(int), void()>, 24>) ==
+                32);
+  static_assert(sizeof(sg::any_callable<void() &&, 56>) == 64);
+  // more aligned than the sbo, so it is stored on the heap
+  struct alignas(16) over_aligned {
+    int value;
+    int operator()() const { return value; }
+  };
+  static_assert(!sg::any_callable<int(), 64>::fit_sbo<over_aligned>);
+  sg::any_callable<int(), 64> f(over_aligned{3});
+  ASSERT_EQ(f(), 3);
+  sg::any_callable<int(), 64> g(std::move(f));
+  ASSERT_TRUE(f.is_empty());
+  ASSERT_EQ(g(), 3);
+}
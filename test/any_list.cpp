@@ -3,8 +3,14 @@
  */
 
 #include "src/any_list.hpp"
+#include "src/callable_utils.hpp"
+#include <algorithm>
 #include <gtest/gtest.h>
+#include <iostream>
+#include <sstream>
+#include <string>
 #include <tuple>
+#include <vector>
 
 template <typename... Ts, typename F, std::size_t... idx>
 void for_tuple_impl(const std::tuple<Ts...> &tuple, F &&func,
@@ -18,8 +24,6 @@ void for_tuple(const std::tuple<Ts...> &tuple, F &&func) {
                  std::make_index_sequence<sizeof...(Ts)>{});
 }
 
-template <typename...> using void_t = int;
-
 TEST(any_list, basic) {
   sg::any_list list;
   std::stringstream ss;
@@ -29,8 +33,259 @@ TEST(any_list, basic) {
   for_tuple(t, [&](auto elem, auto idx) {
     sg::any_list::iterator it = list.begin();
     std::advance(it, idx);
-    ASSERT_EQ(it->template check<decltype(elem)>(), true)
+    ASSERT_EQ(it->template check<decltype(elem)>(), true);
     ss << it->as<decltype(elem)>() << " ";
   });
   std::cout << ss.str() << std::endl;
 }
+
+TEST(any_list, type_checks) {
+  sg::any_list list;
+  std::string two = "two";
+  list.push_back(1);
+  list.push_back(two);
+  const sg::any_list &clist = list;
+
+  ASSERT_TRUE(list.check_front<int>());
+  ASSERT_FALSE(list.check_front<long>());
+  ASSERT_TRUE(list.check_back<std::string>());
+  auto it = list.begin();
+  ASSERT_EQ(it->type(), sg::type_id<int>());
+  ASSERT_EQ(*it->get_if<int>(), 1);
+  ASSERT_EQ(it->get_if<std::string>(), nullptr);
+  ++it;
+  ASSERT_EQ(it->get_if<std::string>()->size(), 3u);
+  ASSERT_EQ(clist.begin()->as<int>(), 1);
+  ASSERT_EQ(clist.begin()->get_if<float>(), nullptr);
+}
+
+namespace {
+
+template <typename T> std::vector<T> values_of(const sg::any_list &list) {
+  std::vector<T> out;
+  for (auto it = list.begin(); it != list.end(); ++it)
+    out.push_back(it->as<T>());
+  return out;
+}
+
+sg::any_list iota_list(int first, int last) {
+  sg::any_list list;
+  for (int i = first; i < last; i++)
+    list.push_back(i);
+  return list;
+}
+
+} // namespace
+
+TEST(any_list, long_list_teardown) {
+  {
+    sg::any_list list;
+    for (int i = 0; i < 1000000; i++)
+      list.push_back(i);
+    for (int i = 0; i < 1000; i++)
+      list.push_back(std::to_string(i));
+  }
+  sg::any_list list = iota_list(0, 1000000);
+  list.clear();
+  ASSERT_TRUE(list.empty());
+  list.push_back(1);
+  ASSERT_EQ(list.front<int>(), 1);
+}
+
+TEST(any_list, pop) {
+  sg::any_list list = iota_list(0, 5);
+  list.pop_front();
+  list.pop_back();
+  ASSERT_EQ(values_of<int>(list), (std::vector<int>{1, 2, 3}));
+  auto it = list.begin();
+  ++it;
+  list.pop_next(it);
+  list.pop_prev(it);
+  ASSERT_EQ(values_of<int>(list), (std::vector<int>{2}));
+  list.push_prev(it, 1);
+  list.push_next(it, 3);
+  ASSERT_EQ(values_of<int>(list), (std::vector<int>{1, 2, 3}));
+  list.pop(it);
+  ASSERT_EQ(values_of<int>(list), (std::vector<int>{1, 3}));
+}
+
+TEST(any_list, splice) {
+  sg::any_list a = iota_list(0, 3);
+  sg::any_list b = iota_list(10, 13);
+  a.splice(a.end(), b);
+  ASSERT_TRUE(b.empty());
+  ASSERT_EQ(values_of<int>(a), (std::vector<int>{0, 1, 2, 10, 11, 12}));
+
+  sg::any_list c = iota_list(20, 22);
+  auto second = a.begin();
+  ++second;
+  a.splice(second, c);
+  ASSERT_EQ(values_of<int>(a),
+            (std::vector<int>{0, 20, 21, 1, 2, 10, 11, 12}));
+
+  sg::any_list d;
+  auto first = a.begin();
+  auto last = first;
+  std::advance(last, 3);
+  d.splice(d.end(), a, first, last);
+  ASSERT_EQ(values_of<int>(d), (std::vector<int>{0, 20, 21}));
+  ASSERT_EQ(values_of<int>(a), (std::vector<int>{1, 2, 10, 11, 12}));
+  a.push_front(0);
+  ASSERT_EQ(a.front<int>(), 0);
+  d.push_back(22);
+  ASSERT_EQ(d.back<int>(), 22);
+}
+
+TEST(any_list, take) {
+  sg::any_list list = iota_list(0, 6);
+  auto middle = list.begin();
+  std::advance(middle, 2);
+  auto last = middle;
+  std::advance(last, 2);
+  sg::any_list taken = list.take(middle, last);
+  ASSERT_EQ(values_of<int>(taken), (std::vector<int>{2, 3}));
+  ASSERT_EQ(values_of<int>(list), (std::vector<int>{0, 1, 4, 5}));
+  sg::any_list tail = list.take(list.begin());
+  ASSERT_TRUE(list.empty());
+  ASSERT_EQ(values_of<int>(tail), (std::vector<int>{0, 1, 4, 5}));
+  sg::any_list moved(std::move(tail));
+  ASSERT_TRUE(tail.empty());
+  ASSERT_EQ(moved.back<int>(), 5);
+}
+
+namespace {
+
+struct construct_counter {
+  static inline int constructions = 0;
+  int value;
+  explicit construct_counter(int v) : value{v} { constructions++; }
+  construct_counter(const construct_counter &other) : value{other.value} {
+    constructions++;
+  }
+};
+
+struct job : sg::any_list_hook<job> {
+  int id;
+  explicit job(int i) : id{i} {}
+};
+
+} // namespace
+
+TEST(any_list, single_construction) {
+  sg::any_list list;
+  list.emplace_back<construct_counter>(1);
+  list.emplace_front<construct_counter>(2);
+  list.emplace_next<construct_counter>(list.begin(), 3);
+  ASSERT_EQ(construct_counter::constructions, 3);
+  ASSERT_EQ(list.front<construct_counter>().value, 2);
+  list.push_back(std::string("moved"));
+  ASSERT_EQ(list.back<std::string>(), "moved");
+}
+
+TEST(any_list, intrusive_hook) {
+  job a{1}, b{2}, c{3}, d{5};
+  sg::any_list list;
+  ASSERT_FALSE(a.is_linked());
+  list.link_back(b);
+  list.link_front(a);
+  list.push_back(4);
+  list.link_next(list.begin(), c);
+  ASSERT_TRUE(a.is_linked());
+
+  std::vector<int> ids;
+  for (auto it = list.begin(); it != list.end(); ++it) {
+    if (auto *j = it->get_if<job>())
+      ids.push_back(j->id);
+    else
+      ids.push_back(it->as<int>());
+  }
+  ASSERT_EQ(ids, (std::vector<int>{1, 3, 2, 4}));
+  ASSERT_EQ(&list.begin()->as<job>(), &a);
+  list.link_back(d);
+  ASSERT_EQ(&list.front<job>(), &a);
+  ASSERT_EQ(&list.back<job>(), &d);
+  ASSERT_EQ(list.back<job>().id, 5);
+  list.pop_back();
+  ASSERT_FALSE(d.is_linked());
+
+  list.unlink(c);
+  ASSERT_FALSE(c.is_linked());
+  list.pop_front();
+  ASSERT_FALSE(a.is_linked());
+  ASSERT_EQ(a.id, 1);
+  job copy = b;
+  ASSERT_FALSE(copy.is_linked());
+  list.clear();
+  ASSERT_FALSE(b.is_linked());
+  list.link_back(a);
+  list.unlink(a);
+}
+
+TEST(any_list, index_for_each) {
+  sg::any_list list;
+  job hooked{7};
+  for (int i = 0; i < 100; i++) {
+    list.push_back(i);
+    if (i % 10 == 0)
+      list.push_back(std::to_string(i));
+  }
+  list.link_back(hooked);
+
+  sg::any_list_index index(list);
+  ASSERT_EQ(index.count<int>(), 100u);
+  ASSERT_EQ(index.count<std::string>(), 10u);
+  ASSERT_EQ(index.count<job>(), 1u);
+  ASSERT_EQ(index.count<double>(), 0u);
+
+  std::vector<int> ints;
+  index.for_each<int>([&](int v) { ints.push_back(v); });
+  ASSERT_EQ(ints.size(), 100u);
+  ASSERT_TRUE(std::is_sorted(ints.begin(), ints.end()));
+  std::string joined;
+  index.for_each<std::string>([&](const std::string &s) { joined += s; });
+  ASSERT_EQ(joined, "0102030405060708090");
+  index.for_each<job>([&](job &j) { ASSERT_EQ(&j, &hooked); });
+  index.for_each<double>([](double) { FAIL(); });
+
+  list.push_front(3.5);
+  index.add(list.begin());
+  ASSERT_EQ(index.count<double>(), 1u);
+  list.unlink(hooked);
+  EXPECT_DEBUG_DEATH(index.count<int>(), "modified since the index");
+  index.rebuild(list);
+  ASSERT_EQ(index.count<job>(), 0u);
+  list.push_front(1);
+  EXPECT_DEBUG_DEATH(index.count<int>(), "modified since the index");
+  index.add(list.begin());
+  ASSERT_EQ(index.count<int>(), 101u);
+}
+
+TEST(any_list, visit_all) {
+  sg::any_list list;
+  job hooked{5};
+  list.push_back(1);
+  list.push_back(std::string("two"));
+  list.link_back(hooked);
+  list.push_back(4.0);
+  list.push_back('c');
+
+  std::string trace;
+  list.visit_all<int, std::string, job, double>(sg::overloaded{
+      [&](int v) { trace += "i" + std::to_string(v); },
+      [&](std::string &s) { trace += "s" + s; },
+      [&](job &j) { trace += "j" + std::to_string(j.id); },
+      [&](double d) { trace += "d" + std::to_string(int(d)); },
+      [&](auto &node) { trace += node.template check<char>() ? "c" : "?"; }});
+  ASSERT_EQ(trace, "i1stwoj5d4c");
+
+  int ints = 0;
+  list.visit_all<int>([&](int) { ints++; });
+  ASSERT_EQ(ints, 1);
+  list.unlink(hooked);
+}
+
+TEST(any_list, type_index) {
+  ASSERT_EQ(sg::type_index<int>(), sg::type_index<int>());
+  ASSERT_NE(sg::type_index<int>(), sg::type_index<long>());
+  ASSERT_EQ(sg::type_index(sg::type_id<long>()), sg::type_index<long>());
+}
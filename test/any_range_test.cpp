@@ -0,0 +1,146 @@
+/*
+ * tests for any_range
+ */
+
+#include "src/any_range.hpp"
+#include "src/fixed_buffer.hpp"
+#include <gtest/gtest.h>
+#include <iterator>
+#include <list>
+#include <numeric>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+/// source counting from 0 to limit, reports how many batches were pulled.
+struct counting_source {
+  int next = 0;
+  int limit;
+  int *batches;
+  std::size_t next_batch(sg::span<int> out) {
+    ++*batches;
+    std::size_t count = 0;
+    for (; count < out.size() && next < limit; count++)
+      out[count] = next++;
+    return count;
+  }
+};
+
+template <typename T, std::size_t N>
+std::vector<T> collect(sg::any_range<T, N> &range) {
+  std::vector<T> result;
+  range.for_each([&](const T &value) { result.push_back(value); });
+  return result;
+}
+
+} // namespace
+
+TEST(any_range, empty) {
+  sg::any_range<int> range;
+  ASSERT_FALSE(range);
+  int buffer[4];
+  ASSERT_EQ(range.next_batch(buffer), 0u);
+}
+
+TEST(any_range, vector) {
+  std::vector<int> values(1000);
+  std::iota(values.begin(), values.end(), 0);
+  auto range = sg::any_range<int>::over(values);
+  ASSERT_TRUE(range);
+  ASSERT_EQ(collect(range), values);
+  int buffer[4];
+  ASSERT_EQ(range.next_batch(buffer), 0u);
+}
+
+TEST(any_range, next_batch) {
+  std::vector<int> values{1, 2, 3, 4, 5};
+  sg::any_range<int> range(values.begin(), values.end());
+  int buffer[2];
+  ASSERT_EQ(range.next_batch(buffer), 2u);
+  ASSERT_EQ(buffer[0], 1);
+  ASSERT_EQ(range.next_batch(buffer), 2u);
+  ASSERT_EQ(buffer[1], 4);
+  ASSERT_EQ(range.next_batch(buffer), 1u);
+  ASSERT_EQ(buffer[0], 5);
+  ASSERT_EQ(range.next_batch(buffer), 0u);
+}
+
+TEST(any_range, list) {
+  std::list<int> values{3, 1, 4, 1, 5};
+  auto range = sg::any_range<int>::over(values);
+  ASSERT_EQ(collect(range), std::vector<int>(values.begin(), values.end()));
+}
+
+TEST(any_range, fixed_buffer) {
+  utils::fixed_buffer<long> buffer(10);
+  for (long i = 0; i < 10; i++)
+    buffer.emplace(i * i);
+  auto range = sg::any_range<long>::over(buffer);
+  ASSERT_EQ(collect(range),
+            std::vector<long>(buffer.begin(), buffer.end()));
+}
+
+TEST(any_range, input_iterators) {
+  static_assert(!std::is_constructible_v<sg::any_range<int>, int, int>);
+  static_assert(
+      !std::is_constructible_v<sg::any_range<int>, std::string *,
+                               std::string *>);
+  std::istringstream in("1 2 3");
+  sg::any_range<int> range{std::istream_iterator<int>(in),
+                           std::istream_iterator<int>()};
+  ASSERT_EQ(collect(range), (std::vector<int>{1, 2, 3}));
+  ASSERT_EQ(collect(range), std::vector<int>{});
+}
+
+TEST(any_range, pointers) {
+  std::vector<std::string> values{"a", "b", "c"};
+  std::vector<const std::string *> pointers;
+  for (auto &v : values)
+    pointers.push_back(&v);
+  auto range = sg::any_range<const std::string *>::over(pointers);
+  ASSERT_EQ(collect(range), pointers);
+}
+
+TEST(any_range, generator) {
+  int next = 0;
+  auto range = sg::any_range<int>::from_generator([&]() -> std::optional<int> {
+    if (next == 100)
+      return std::nullopt;
+    return next++;
+  });
+  std::vector<int> expected(100);
+  std::iota(expected.begin(), expected.end(), 0);
+  ASSERT_EQ(collect(range), expected);
+  int buffer[4];
+  ASSERT_EQ(range.next_batch(buffer), 0u);
+  ASSERT_EQ(next, 100);
+}
+
+TEST(any_range, source) {
+  int batches = 0;
+  static_assert(sg::any_range<int>::fit_sbo<counting_source>);
+  sg::any_range<int> range(counting_source{0, 1000, &batches});
+  std::vector<int> result = collect(range);
+  ASSERT_EQ(result.size(), 1000u);
+  ASSERT_EQ(result.back(), 999);
+  // 15 full batches of 64, then one partial of 40 and one empty
+  ASSERT_EQ(batches, 17);
+}
+
+TEST(any_range, move) {
+  int batches = 0;
+  sg::any_range<int> a(counting_source{0, 10, &batches});
+  int buffer[4];
+  ASSERT_EQ(a.next_batch(buffer), 4u);
+  sg::any_range<int> b = std::move(a);
+  ASSERT_FALSE(a);
+  ASSERT_EQ(b.next_batch(buffer), 4u);
+  ASSERT_EQ(buffer[0], 4);
+  sg::any_range<int, 8> small(counting_source{0, 10, &batches});
+  sg::any_range<int, 8> moved = std::move(small);
+  ASSERT_EQ(collect(moved).size(), 10u);
+  a = std::move(b);
+  ASSERT_EQ(collect(a).size(), 2u);
+}
@@ -0,0 +1,144 @@
+/*
+ * tests for any_sbo
+ */
+
+#include "src/any_sbo.hpp"
+#include <array>
+#include <cstdint>
+#include <gtest/gtest.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct counted {
+  static inline int alive = 0;
+  int value;
+  explicit counted(int v) : value{v} { alive++; }
+  counted(const counted &other) noexcept : value{other.value} { alive++; }
+  counted(counted &&other) noexcept : value{other.value} { alive++; }
+  ~counted() { alive--; }
+};
+
+using big = std::array<long, 16>;
+
+} // namespace
+
+TEST(any_sbo, empty) {
+  sg::any_sbo<> a;
+  ASSERT_FALSE(a.has_value());
+  ASSERT_EQ(a.type(), sg::type_id<void>());
+  ASSERT_EQ(sg::any_cast<int>(&a), nullptr);
+  ASSERT_THROW(sg::any_cast<int>(a), std::bad_any_cast);
+}
+
+TEST(any_sbo, store_and_cast) {
+  sg::any_sbo<> a = 42;
+  ASSERT_TRUE(a.has_value());
+  ASSERT_EQ(a.type(), sg::type_id<int>());
+  ASSERT_EQ(sg::any_cast<int>(a), 42);
+  ASSERT_EQ(sg::any_cast<long>(&a), nullptr);
+  *sg::any_cast<int>(&a) = 3;
+  ASSERT_EQ(sg::any_cast<const int &>(a), 3);
+  a = std::string("hello");
+  ASSERT_EQ(sg::any_cast<std::string &>(a), "hello");
+  ASSERT_EQ(sg::any_cast<int>(&a), nullptr);
+  const sg::any_sbo<> &ca = a;
+  ASSERT_EQ(*sg::any_cast<std::string>(&ca), "hello");
+}
+
+TEST(any_sbo, sbo_and_heap) {
+  ASSERT_TRUE(sg::any_sbo<>::fit_sbo<std::string>);
+  ASSERT_FALSE(sg::any_sbo<>::fit_sbo<big>);
+  big value{};
+  value[15] = 7;
+  sg::any_sbo<> a = value;
+  sg::any_sbo<> b = a;
+  sg::any_sbo<> c = std::move(a);
+  ASSERT_FALSE(a.has_value());
+  ASSERT_EQ(sg::any_cast<big &>(b)[15], 7);
+  ASSERT_EQ(sg::any_cast<big &>(c)[15], 7);
+  ASSERT_NE(sg::any_cast<big>(&b), sg::any_cast<big>(&c));
+  sg::any_sbo<256> d = value;
+  ASSERT_EQ(sg::any_cast<big &>(d)[15], 7);
+}
+
+TEST(any_sbo, lifetime) {
+  {
+    sg::any_sbo<> a(std::in_place_type<counted>, 1);
+    ASSERT_EQ(counted::alive, 1);
+    sg::any_sbo<> b = a;
+    ASSERT_EQ(counted::alive, 2);
+    sg::any_sbo<> c = std::move(a);
+    ASSERT_EQ(counted::alive, 2);
+    ASSERT_EQ(sg::any_cast<counted &>(c).value, 1);
+    c.emplace<counted>(2);
+    ASSERT_EQ(counted::alive, 2);
+    ASSERT_EQ(sg::any_cast<counted &>(c).value, 2);
+    c = 1;
+    ASSERT_EQ(counted::alive, 1);
+    b.reset();
+    ASSERT_EQ(counted::alive, 0);
+  }
+  ASSERT_EQ(counted::alive, 0);
+}
+
+TEST(any_sbo, swap) {
+  sg::any_sbo<> a = 1;
+  sg::any_sbo<> b = std::string("b");
+  a.swap(b);
+  ASSERT_EQ(sg::any_cast<std::string>(a), "b");
+  ASSERT_EQ(sg::any_cast<int>(b), 1);
+}
+
+TEST(any_sbo, shared_ptr) {
+  auto ptr = std::make_shared<int>(3);
+  {
+    sg::any_sbo<16> a = ptr;
+    sg::any_sbo<16> b = a;
+    ASSERT_EQ(ptr.use_count(), 3);
+    sg::any_sbo<16> c = std::move(b);
+    ASSERT_EQ(ptr.use_count(), 3);
+  }
+  ASSERT_EQ(ptr.use_count(), 1);
+}
+
+TEST(any_sbo, aligned) {
+  struct alignas(32) vec {
+    float v[8];
+  };
+  sg::any_sbo<32, 32> a = vec{{1, 2, 3, 4, 5, 6, 7, 8}};
+  ASSERT_EQ(reinterpret_cast<std::uintptr_t>(sg::any_cast<vec>(&a)) % 32, 0u);
+  ASSERT_EQ(sg::any_cast<vec &>(a).v[7], 8);
+}
+
+TEST(any_sbo, reuse_heap_block) {
+  big value{};
+  sg::any_sbo<> a = value;
+  big *block = sg::any_cast<big>(&a);
+  a = value;
+  ASSERT_EQ(sg::any_cast<big>(&a), block);
+  a.reset();
+  a.emplace<big>();
+  ASSERT_EQ(sg::any_cast<big>(&a), block);
+  a.reset();
+  a.shrink_to_fit();
+  a = 1;
+  ASSERT_EQ(sg::any_cast<int>(a), 1);
+}
+
+TEST(any_sbo, assign_from_own_value) {
+  sg::any_sbo<> a = std::string(64, 'a');
+  a = sg::any_cast<std::string &>(a);
+  ASSERT_EQ(sg::any_cast<std::string &>(a), std::string(64, 'a'));
+  big value{};
+  value[15] = 3;
+  sg::any_sbo<> b = value;
+  b = sg::any_cast<big &>(b);
+  ASSERT_EQ(sg::any_cast<big &>(b)[15], 3);
+  // the new value doesn't fit in the storage of the current one
+  sg::any_sbo<> c = std::vector<big>(2, value);
+  c = sg::any_cast<std::vector<big> &>(c)[1];
+  ASSERT_EQ(sg::any_cast<big &>(c)[15], 3);
+}
@@ -0,0 +1,121 @@
+/*
+ * tests for any_vector
+ */
+
+#include "src/any_vector.hpp"
+#include <gtest/gtest.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct draw {
+  int x, y;
+};
+
+struct counted {
+  static inline int alive = 0;
+  counted() { alive++; }
+  counted(counted &&) noexcept { alive++; }
+  ~counted() { alive--; }
+};
+
+} // namespace
+
+TEST(any_vector, emplace_and_iterate) {
+  sg::any_vector commands;
+  ASSERT_TRUE(commands.empty());
+  commands.emplace_back<draw>(draw{1, 2});
+  commands.push_back(std::string("label"));
+  commands.push_back(3.5);
+  commands.emplace_back<std::unique_ptr<int>>(new int(4));
+  ASSERT_EQ(commands.size(), 4u);
+  ASSERT_EQ(commands.bytes(), sg::any_vector::entry_size<draw>() +
+                                  sg::any_vector::entry_size<std::string>() +
+                                  sg::any_vector::entry_size<double>() +
+                                  sg::any_vector::entry_size<
+                                      std::unique_ptr<int>>());
+
+  std::vector<sg::type_id_t> types;
+  for (auto entry : commands)
+    types.push_back(entry.type());
+  ASSERT_EQ(types,
+            (std::vector<sg::type_id_t>{sg::type_id<draw>(),
+                                        sg::type_id<std::string>(),
+                                        sg::type_id<double>(),
+                                        sg::type_id<std::unique_ptr<int>>()}));
+  auto it = commands.begin();
+  ASSERT_EQ((*it).as<draw>().y, 2);
+  ASSERT_EQ((*it).get_if<std::string>(), nullptr);
+  ++it;
+  ASSERT_EQ(*(*it).get_if<std::string>(), "label");
+}
+
+TEST(any_vector, growth_relocates) {
+  sg::any_vector values;
+  for (int i = 0; i < 1000; i++) {
+    if (i % 2)
+      values.push_back(std::to_string(i));
+    else
+      values.push_back(i);
+  }
+  ASSERT_EQ(values.size(), 1000u);
+  int expected = 0;
+  for (auto entry : values) {
+    if (expected % 2)
+      ASSERT_EQ(entry.as<std::string>(), std::to_string(expected));
+    else
+      ASSERT_EQ(entry.as<int>(), expected);
+    expected++;
+  }
+}
+
+TEST(any_vector, for_each_of_and_visit) {
+  sg::any_vector commands;
+  for (int i = 0; i < 10; i++) {
+    commands.push_back(draw{i, i});
+    commands.push_back(i);
+  }
+  commands.push_back(std::string("end"));
+
+  int sum = 0;
+  commands.for_each_of<draw>([&](draw &d) { sum += d.x; });
+  ASSERT_EQ(sum, 45);
+
+  int draws = 0, ints = 0, others = 0;
+  struct visitor {
+    int &draws, &ints, &others;
+    void operator()(draw &) { draws++; }
+    void operator()(int &) { ints++; }
+    void operator()(sg::any_vector::entry) { others++; }
+  };
+  commands.visit<draw, int>(visitor{draws, ints, others});
+  ASSERT_EQ(draws, 10);
+  ASSERT_EQ(ints, 10);
+  ASSERT_EQ(others, 1);
+
+  int strings = 0;
+  commands.visit<std::string>([&](std::string &s) {
+    ASSERT_EQ(s, "end");
+    strings++;
+  });
+  ASSERT_EQ(strings, 1);
+}
+
+TEST(any_vector, destruction) {
+  {
+    sg::any_vector values;
+    for (int i = 0; i < 100; i++)
+      values.emplace_back<counted>();
+    ASSERT_EQ(counted::alive, 100);
+    values.clear();
+    ASSERT_EQ(counted::alive, 0);
+    ASSERT_TRUE(values.empty());
+    values.emplace_back<counted>();
+    sg::any_vector moved(std::move(values));
+    ASSERT_EQ(moved.size(), 1u);
+    ASSERT_EQ(counted::alive, 1);
+  }
+  ASSERT_EQ(counted::alive, 0);
+}
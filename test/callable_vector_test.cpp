@@ -0,0 +1,119 @@
+/*
+ * tests for callable_vector
+ */
+
+#include "src/callable_vector.hpp"
+#include <algorithm>
+#include <gtest/gtest.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct event {
+  std::string log;
+};
+
+struct append {
+  char c;
+  void operator()(event &e) const { e.log.push_back(c); }
+};
+
+} // namespace
+
+TEST(callable_vector, invoke_all) {
+  sg::callable_vector<void(event &)> vec;
+  int count = 0;
+  vec.insert([&](event &) { count++; });
+  vec.insert(append{'a'});
+  vec.insert(append{'b'});
+  vec.insert([&](event &) { count += 10; });
+  ASSERT_EQ(vec.size(), 4u);
+  ASSERT_EQ(vec.group_count(), 3u);
+  event e;
+  vec.invoke_all(e);
+  ASSERT_EQ(count, 11);
+  ASSERT_EQ(e.log, "ab");
+}
+
+TEST(callable_vector, erase_keeps_handles) {
+  sg::callable_vector<void(event &)> vec;
+  std::vector<sg::callable_vector<void(event &)>::handle> handles;
+  for (char c = 'a'; c <= 'z'; c++)
+    handles.push_back(vec.insert(append{c}));
+  vec.erase(handles[0]);
+  vec.erase(handles[10]);
+  ASSERT_EQ(vec.contains(handles[0]), false);
+  ASSERT_EQ(vec.contains(handles[1]), true);
+  ASSERT_EQ(vec.size(), 24u);
+  for (std::size_t idx = 1; idx < handles.size(); idx++)
+    if (idx != 10)
+      vec.erase(handles[idx]);
+  ASSERT_EQ(vec.empty(), true);
+  event e;
+  vec.invoke_all(e);
+  ASSERT_EQ(e.log, "");
+  auto h = vec.insert(append{'x'});
+  ASSERT_EQ(vec.contains(handles[0]), false);
+  ASSERT_EQ(vec.contains(h), true);
+  vec.invoke_all(e);
+  ASSERT_EQ(e.log, "x");
+}
+
+TEST(callable_vector, erase_moves_last) {
+  sg::callable_vector<void(event &)> vec;
+  auto a = vec.insert(append{'a'});
+  vec.insert(append{'b'});
+  auto c = vec.insert(append{'c'});
+  vec.erase(a);
+  event e;
+  vec.invoke_all(e);
+  std::sort(e.log.begin(), e.log.end());
+  ASSERT_EQ(e.log, "bc");
+  vec.erase(c);
+  e.log.clear();
+  vec.invoke_all(e);
+  ASSERT_EQ(e.log, "b");
+}
+
+TEST(callable_vector, destroys_elements) {
+  auto counter = std::make_shared<int>(0);
+  {
+    sg::callable_vector<int(int)> vec;
+    std::vector<sg::callable_vector<int(int)>::handle> handles;
+    for (int i = 0; i < 20; i++)
+      handles.push_back(vec.insert([counter](int a) { return a + *counter; }));
+    ASSERT_EQ(counter.use_count(), 21);
+    vec.erase(handles[3]);
+    ASSERT_EQ(counter.use_count(), 20);
+    sg::callable_vector<int(int)> other(std::move(vec));
+    ASSERT_EQ(counter.use_count(), 20);
+    other.clear();
+    ASSERT_EQ(counter.use_count(), 1);
+    other.insert([counter](int a) { return a; });
+    ASSERT_EQ(counter.use_count(), 2);
+  }
+  ASSERT_EQ(counter.use_count(), 1);
+}
+
+TEST(callable_vector, invoke_all_results) {
+  sg::callable_vector<int(int)> vec;
+  vec.insert([](int a) { return a + 1; });
+  vec.insert([](int a) { return a * 10; });
+  vec.insert([](int a) { return a + 2; });
+  std::vector<int> results(vec.size());
+  ASSERT_EQ(vec.invoke_all(results.data(), 3), results.data() + 3);
+  std::sort(results.begin(), results.end());
+  ASSERT_EQ(results, (std::vector<int>{4, 5, 30}));
+}
+
+TEST(callable_vector, self_move_assign) {
+  sg::callable_vector<void(event &)> vec;
+  vec.insert(append{'a'});
+  auto &same = vec;
+  vec = std::move(same);
+  event e;
+  vec.invoke_all(e);
+  ASSERT_EQ(e.log, "a");
+}
@@ -0,0 +1,109 @@
+/*
+ * tests for concurrent_fixed_buffer
+ */
+
+#include "src/concurrent_fixed_buffer.hpp"
+#include <atomic>
+#include <gtest/gtest.h>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct record {
+  static inline std::atomic<int> alive{0};
+  std::atomic<long> value;
+  explicit record(long v) : value{v} {
+    if (v < 0)
+      throw std::runtime_error("negative");
+    alive++;
+  }
+  record(const record &) = delete;
+  ~record() { alive--; }
+};
+
+} // namespace
+
+TEST(concurrent_fixed_buffer, emplace) {
+  utils::concurrent_fixed_buffer<std::string> buffer(2);
+  ASSERT_EQ(buffer.capacity(), 2u);
+  ASSERT_EQ(buffer.emplace(3, 'a'), "aaa");
+  ASSERT_NE(buffer.try_emplace("b"), nullptr);
+  ASSERT_TRUE(buffer.full());
+  ASSERT_EQ(buffer.try_emplace("c"), nullptr);
+  ASSERT_THROW(buffer.emplace("c"), std::length_error);
+  ASSERT_EQ(buffer.size(), 2u);
+  ASSERT_EQ(buffer[1], "b");
+  ASSERT_EQ(*buffer.get(0), "aaa");
+  ASSERT_EQ(buffer.get(2), nullptr);
+  buffer.clear();
+  ASSERT_EQ(buffer.size(), 0u);
+  ASSERT_EQ(buffer.get(0), nullptr);
+  ASSERT_EQ(buffer.emplace("d"), "d");
+}
+
+TEST(concurrent_fixed_buffer, failed_construction) {
+  {
+    utils::concurrent_fixed_buffer<record> buffer(4);
+    buffer.emplace(1);
+    ASSERT_THROW(buffer.emplace(-1), std::runtime_error);
+    buffer.emplace(2);
+    ASSERT_EQ(buffer.size(), 3u);
+    ASSERT_EQ(buffer.get(1), nullptr);
+    long sum = 0;
+    buffer.for_each([&](record &r) { sum += r.value; });
+    ASSERT_EQ(sum, 3);
+    ASSERT_EQ(record::alive.load(), 2);
+  }
+  ASSERT_EQ(record::alive.load(), 0);
+}
+
+TEST(concurrent_fixed_buffer, emplace_n) {
+  utils::concurrent_fixed_buffer<record> buffer(10);
+  auto first = buffer.emplace_n(4, [](std::size_t i) { return record(i); });
+  ASSERT_EQ(first.size(), 4u);
+  ASSERT_EQ(first[3].value.load(), 3);
+  ASSERT_THROW(buffer.emplace_n(
+                   3, [](std::size_t i) { return record(i == 1 ? -1 : 1); }),
+               std::runtime_error);
+  ASSERT_NE(buffer.get(4), nullptr);
+  ASSERT_EQ(buffer.get(5), nullptr);
+  ASSERT_EQ(buffer.get(6), nullptr);
+  auto last = buffer.emplace_n(8, [](std::size_t i) { return record(i); });
+  ASSERT_EQ(last.size(), 3u);
+  ASSERT_TRUE(buffer.full());
+  ASSERT_EQ(buffer.emplace_n(1, [](std::size_t) { return record(0); }).size(),
+            0u);
+}
+
+TEST(concurrent_fixed_buffer, concurrent_append) {
+  constexpr int thread_count = 8;
+  constexpr long per_thread = 10000;
+  utils::concurrent_fixed_buffer<long> buffer(thread_count * per_thread);
+  std::atomic<bool> done{false};
+  std::thread reader([&] {
+    while (!done.load())
+      buffer.for_each([](long v) { ASSERT_GE(v, 0); });
+  });
+  std::vector<std::thread> writers;
+  for (int t = 0; t < thread_count; t++)
+    writers.emplace_back([&buffer, t] {
+      for (long i = 0; i < per_thread / 2; i++)
+        buffer.emplace(t * per_thread + i);
+      for (long i = per_thread / 2; i < per_thread; i += 100)
+        buffer.emplace_n(100, [&](std::size_t j) {
+          return t * per_thread + i + long(j);
+        });
+    });
+  for (auto &writer : writers)
+    writer.join();
+  done = true;
+  reader.join();
+  ASSERT_TRUE(buffer.full());
+  std::vector<bool> seen(thread_count * per_thread);
+  buffer.for_each([&](long v) { seen[v] = true; });
+  for (bool s : seen)
+    ASSERT_TRUE(s);
+}
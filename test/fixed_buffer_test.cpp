@@ -0,0 +1,249 @@
+/*
+ * tests for fixed_buffer
+ */
+
+#include "src/StackedBumpAllocator.hpp"
+#include "src/fixed_buffer.hpp"
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <gtest/gtest.h>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct alignas(64) padded_counter {
+  std::atomic<long> value{0};
+};
+
+struct shard {
+  static inline std::atomic<long> alive{0};
+  static inline std::atomic<long> throw_at{-1};
+  std::mutex lock;
+  long id = -1;
+  explicit shard(long base) {
+    if (alive.fetch_add(1) == throw_at) {
+      alive--;
+      throw std::runtime_error("shard");
+    }
+    id = base;
+  }
+  ~shard() { alive--; }
+};
+
+template <typename T> bool is_aligned(const T *ptr, std::size_t align) {
+  return reinterpret_cast<std::uintptr_t>(ptr) % align == 0;
+}
+
+} // namespace
+
+TEST(fixed_buffer, over_aligned_type) {
+  utils::fixed_buffer<padded_counter> counters(8);
+  for (int i = 0; i < 8; i++)
+    counters.emplace();
+  ASSERT_EQ(counters.capacity(), 8u);
+  for (auto &counter : counters)
+    ASSERT_TRUE(is_aligned(&counter, 64));
+  counters[3].value++;
+  ASSERT_EQ(counters.at(3).value.load(), 1);
+}
+
+TEST(fixed_buffer, alignment_parameter) {
+  utils::fixed_buffer<float, 64> values(100);
+  ASSERT_TRUE(is_aligned(values.begin(), 64));
+  values.emplace(1.f);
+  ASSERT_EQ(values.size(), 1u);
+}
+
+TEST(fixed_buffer, size_overflow) {
+  using buffer = utils::fixed_buffer<std::uint64_t>;
+  ASSERT_THROW(buffer(buffer::max_size() + 1), std::length_error);
+  ASSERT_THROW(buffer(SIZE_MAX / 4), std::length_error);
+}
+
+TEST(fixed_buffer, arena_allocator) {
+  using arena_type = llvm::StackedBumpAllocator<>;
+  using allocator = utils::arena_allocator<arena_type>;
+  arena_type arena;
+  {
+    utils::fixed_buffer<std::string, alignof(std::string), allocator> names(
+        4, allocator(arena));
+    names.emplace("first");
+    names.emplace("second");
+    ASSERT_EQ(names.back(), "second");
+    ASSERT_EQ(&names.get_allocator().arena(), &arena);
+    ASSERT_GE(arena.getBytesAllocated(), 4 * sizeof(std::string));
+
+    auto other = std::move(names);
+    ASSERT_EQ(other.size(), 2u);
+    ASSERT_EQ(names.size(), 0u);
+  }
+  {
+    utils::fixed_buffer<std::string, alignof(std::string), allocator> built(
+        std::allocator_arg, allocator(arena), 3, utils::build, "x");
+    ASSERT_EQ(built.size(), 3u);
+    ASSERT_EQ(built[2], "x");
+    utils::fixed_buffer<long, alignof(long), allocator> parallel(
+        std::allocator_arg, allocator(arena), utils::parallel_policy{2}, 10000,
+        utils::build, 7l);
+    ASSERT_EQ(parallel.size(), 10000u);
+    ASSERT_EQ(parallel[9999], 7);
+  }
+}
+
+TEST(fixed_buffer, huge_page_allocator) {
+  using allocator = utils::huge_page_allocator<4096>;
+  utils::fixed_buffer<int, 64, allocator> large(1 << 20);
+  utils::fixed_buffer<int, 64, allocator> small(16);
+  ASSERT_TRUE(is_aligned(large.begin(), 4096));
+  ASSERT_TRUE(is_aligned(small.begin(), 64));
+  for (int i = 0; i < (1 << 20); i++)
+    large.emplace(i);
+  small.emplace(1);
+  ASSERT_EQ(large[12345], 12345);
+  large.swap(small);
+  ASSERT_EQ(small.size(), std::size_t(1) << 20);
+  ASSERT_EQ(large.size(), 1u);
+
+  utils::fixed_buffer<int, 1 << 16, allocator> page_aligned(1 << 16);
+  ASSERT_TRUE(is_aligned(page_aligned.begin(), 1 << 16));
+  page_aligned.emplace(1);
+  allocator alloc;
+  for (std::size_t align : {4096ul, 1ul << 16, 1ul << 21}) {
+    void *ptr = alloc.allocate(3 << 20, align);
+    ASSERT_NE(ptr, nullptr);
+    ASSERT_TRUE(is_aligned(ptr, align));
+    std::memset(ptr, 1, 3 << 20);
+    alloc.deallocate(ptr, 3 << 20, align);
+  }
+}
+
+TEST(fixed_buffer, clear) {
+  utils::fixed_buffer<std::string> empty(4);
+  empty.clear();
+  ASSERT_EQ(empty.size(), 0u);
+  empty.emplace("a");
+  empty.emplace("b");
+  empty.clear();
+  ASSERT_EQ(empty.size(), 0u);
+  empty.emplace("c");
+  ASSERT_EQ(empty.front(), "c");
+}
+
+TEST(fixed_buffer, parallel_construction) {
+  constexpr std::size_t size = 100000;
+  std::atomic<long> next{0};
+  {
+    utils::fixed_buffer<shard> shards(
+        utils::parallel_policy{4}, size,
+        [&](shard &s) {
+          std::lock_guard<std::mutex> lock(s.lock);
+          s.id += next++;
+        },
+        1);
+    ASSERT_EQ(shards.size(), size);
+    ASSERT_EQ(shard::alive.load(), long(size));
+    std::vector<bool> seen(size + 1);
+    for (auto &s : shards) {
+      ASSERT_GE(s.id, 1);
+      ASSERT_LE(s.id, long(size));
+      ASSERT_FALSE(seen[s.id]);
+      seen[s.id] = true;
+    }
+    shards.clear(utils::par);
+    ASSERT_EQ(shard::alive.load(), 0);
+    ASSERT_EQ(shards.size(), 0u);
+  }
+  ASSERT_EQ(shard::alive.load(), 0);
+}
+
+TEST(fixed_buffer, parallel_teardown) {
+  struct recorded {
+    std::mutex *lock;
+    std::set<std::thread::id> *threads;
+    recorded(std::mutex *l, std::set<std::thread::id> *t)
+        : lock{l}, threads{t} {}
+    ~recorded() {
+      std::lock_guard<std::mutex> guard(*lock);
+      threads->insert(std::this_thread::get_id());
+    }
+  };
+  std::mutex lock;
+  std::set<std::thread::id> threads;
+  {
+    utils::fixed_buffer<recorded> buffer(utils::parallel_policy{4}, 100000,
+                                         utils::build, &lock, &threads);
+  }
+  ASSERT_EQ(threads.size(), 4u);
+  threads.clear();
+  {
+    utils::fixed_buffer<recorded> buffer(100000, utils::build, &lock,
+                                         &threads);
+  }
+  ASSERT_EQ(threads.size(), 1u);
+}
+
+TEST(fixed_buffer, parallel_construction_throws) {
+  shard::throw_at = 50000;
+  ASSERT_THROW(utils::fixed_buffer<shard>(utils::parallel_policy{4}, 100000,
+                                          utils::build, 0),
+               std::runtime_error);
+  shard::throw_at = -1;
+  ASSERT_EQ(shard::alive.load(), 0);
+}
+
+TEST(fixed_buffer, zeroed) {
+  auto table = utils::fixed_buffer<long>::zeroed(1 << 20);
+  ASSERT_EQ(table.size(), std::size_t(1) << 20);
+  ASSERT_EQ(table[0], 0);
+  ASSERT_EQ(table[(1 << 20) - 1], 0);
+  table[1000] = 3;
+
+  auto aligned = utils::fixed_buffer<char, 128>::zeroed(1000);
+  ASSERT_TRUE(is_aligned(aligned.begin(), 128));
+  for (char c : aligned)
+    ASSERT_EQ(c, 0);
+  auto page_aligned = utils::fixed_buffer<long, 4096>::zeroed(1 << 20);
+  ASSERT_TRUE(is_aligned(page_aligned.begin(), 4096));
+  ASSERT_EQ(page_aligned[0], 0);
+  ASSERT_EQ(page_aligned[(1 << 20) - 1], 0);
+
+  using huge = utils::fixed_buffer<int, 64, utils::huge_page_allocator<4096>>;
+  auto mapped = huge::zeroed(1 << 20);
+  auto small = huge::zeroed(16);
+  ASSERT_EQ(mapped[12345], 0);
+  ASSERT_EQ(small[15], 0);
+}
+
+TEST(fixed_buffer, zeroed_from_arena) {
+  using arena_type = llvm::StackedBumpAllocator<>;
+  using allocator = utils::arena_allocator<arena_type>;
+  arena_type arena;
+  arena.PushFrame();
+  std::memset(arena.Allocate(1024, 8), 0xff, 1024);
+  arena.PopFrame();
+  auto buffer = utils::fixed_buffer<int, alignof(int), allocator>::zeroed(
+      256, allocator(arena));
+  for (int v : buffer)
+    ASSERT_EQ(v, 0);
+}
+
+TEST(fixed_buffer, uninitialized_commit) {
+  auto names = utils::fixed_buffer<std::string>::uninitialized(8);
+  ASSERT_EQ(names.size(), 0u);
+  ASSERT_EQ(names.capacity(), 8u);
+  for (int i = 0; i < 3; i++)
+    new (names.uncommitted() + i) std::string(i + 1, 'x');
+  names.commit(3);
+  new (names.uncommitted()) std::string("y");
+  names.commit(1);
+  ASSERT_EQ(names.size(), 4u);
+  ASSERT_EQ(names[2], "xxx");
+  ASSERT_EQ(names.back(), "y");
+}
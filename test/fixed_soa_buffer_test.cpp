@@ -0,0 +1,119 @@
+/*
+ * tests for fixed_soa_buffer
+ */
+
+#include "src/fixed_soa_buffer.hpp"
+#include <atomic>
+#include <cstdint>
+#include <gtest/gtest.h>
+#include <memory>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+struct throw_on {
+  static inline int alive = 0;
+  explicit throw_on(bool do_throw) {
+    if (do_throw)
+      throw std::runtime_error("throw_on");
+    alive++;
+  }
+  throw_on(const throw_on &) = delete;
+  ~throw_on() { alive--; }
+};
+
+struct counted {
+  static inline int alive = 0;
+  counted() { alive++; }
+  counted(const counted &) { alive++; }
+  ~counted() { alive--; }
+};
+
+template <typename T> bool is_aligned(const T *ptr) {
+  return reinterpret_cast<std::uintptr_t>(ptr) % 64 == 0;
+}
+
+} // namespace
+
+TEST(fixed_soa_buffer, emplace_and_access) {
+  utils::fixed_soa_buffer<int, double, std::string> buffer(10);
+  ASSERT_TRUE(buffer.empty());
+  ASSERT_EQ(buffer.capacity(), 10u);
+  for (int i = 0; i < 10; i++) {
+    auto [id, value, name] = buffer.emplace(i, i * 0.5, std::to_string(i));
+    ASSERT_EQ(id, i);
+    ASSERT_EQ(value, i * 0.5);
+    ASSERT_EQ(name, std::to_string(i));
+  }
+  ASSERT_EQ(buffer.size(), 10u);
+  std::get<2>(buffer[3]) = "three";
+  ASSERT_EQ(std::get<2>(buffer.at(3)), "three");
+  ASSERT_EQ(std::get<0>(buffer.back()), 9);
+  ASSERT_THROW(buffer.at(10), std::out_of_range);
+  buffer.pop_back();
+  ASSERT_EQ(buffer.size(), 9u);
+}
+
+TEST(fixed_soa_buffer, field_spans) {
+  utils::fixed_soa_buffer<char, double, float> buffer(1000);
+  for (int i = 0; i < 1000; i++)
+    buffer.emplace(char(i), double(i), float(2 * i));
+  auto ids = buffer.field<0>();
+  auto values = buffer.field<1>();
+  auto halves = buffer.field<2>();
+  ASSERT_EQ(values.size(), 1000u);
+  ASSERT_TRUE(is_aligned(ids.data()));
+  ASSERT_TRUE(is_aligned(values.data()));
+  ASSERT_TRUE(is_aligned(halves.data()));
+  ASSERT_EQ(std::accumulate(values.begin(), values.end(), 0.0),
+            999.0 * 1000 / 2);
+  for (float &f : halves)
+    f /= 2;
+  const auto &cbuffer = buffer;
+  ASSERT_EQ(cbuffer.field<2>()[10], 10.f);
+  ASSERT_EQ(std::get<2>(cbuffer[20]), 20.f);
+}
+
+TEST(fixed_soa_buffer, non_movable_fields) {
+  utils::fixed_soa_buffer<std::atomic<int>, std::unique_ptr<int>> buffer(4);
+  buffer.emplace(1, std::make_unique<int>(2));
+  buffer.emplace();
+  ASSERT_EQ(std::get<0>(buffer[0]).load(), 1);
+  ASSERT_EQ(*std::get<1>(buffer[0]), 2);
+  ASSERT_EQ(std::get<0>(buffer[1]).load(), 0);
+  ASSERT_EQ(std::get<1>(buffer[1]), nullptr);
+}
+
+TEST(fixed_soa_buffer, exception_safety) {
+  {
+    utils::fixed_soa_buffer<counted, throw_on> buffer(4);
+    buffer.emplace(counted{}, false);
+    ASSERT_THROW(buffer.emplace(counted{}, true), std::runtime_error);
+    ASSERT_EQ(buffer.size(), 1u);
+    ASSERT_EQ(counted::alive, 1);
+    ASSERT_EQ(throw_on::alive, 1);
+  }
+  ASSERT_EQ(counted::alive, 0);
+  ASSERT_EQ(throw_on::alive, 0);
+}
+
+TEST(fixed_soa_buffer, move) {
+  utils::fixed_soa_buffer<int, std::string> a(4);
+  a.emplace(1, "a");
+  utils::fixed_soa_buffer<int, std::string> b(std::move(a));
+  ASSERT_EQ(a.size(), 0u);
+  ASSERT_EQ(std::get<1>(b[0]), "a");
+  a = std::move(b);
+  ASSERT_EQ(std::get<1>(a[0]), "a");
+  a.clear();
+  ASSERT_TRUE(a.empty());
+}
+
+TEST(fixed_soa_buffer, too_large) {
+  using buffer = utils::fixed_soa_buffer<int, double>;
+  ASSERT_THROW(buffer(buffer::max_size() + 1), std::length_error);
+  ASSERT_THROW(buffer(SIZE_MAX / 8), std::length_error);
+  ASSERT_THROW(buffer(SIZE_MAX), std::length_error);
+}
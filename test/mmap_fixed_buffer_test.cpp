@@ -0,0 +1,105 @@
+/*
+ * tests for mmap_fixed_buffer
+ */
+
+#include "src/mmap_fixed_buffer.hpp"
+#include <cstdio>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <unistd.h>
+
+namespace {
+
+struct record {
+  std::uint64_t key;
+  double value;
+  char tag[4];
+};
+
+std::string temp_path(const std::string &name) {
+  return testing::TempDir() + "mmap_fixed_buffer_" + name + "_" +
+         std::to_string(::getpid());
+}
+
+void write_records(const std::string &path, int count) {
+  auto buffer = utils::mmap_fixed_buffer<record>::create(path, 1000);
+  for (int i = 0; i < count; i++)
+    buffer.emplace(record{std::uint64_t(i), i * 0.5, "abc"});
+  buffer.sync();
+}
+
+} // namespace
+
+TEST(mmap_fixed_buffer, create_and_reopen) {
+  std::string path = temp_path("reopen");
+  write_records(path, 100);
+  {
+    auto buffer = utils::mmap_fixed_buffer<record>::open(path);
+    ASSERT_FALSE(buffer.writable());
+    ASSERT_EQ(buffer.size(), 100u);
+    ASSERT_EQ(buffer.capacity(), 1000u);
+    ASSERT_EQ(buffer[42].key, 42u);
+    ASSERT_EQ(buffer.back().value, 49.5);
+    ASSERT_STREQ(buffer.at(7).tag, "abc");
+    ASSERT_THROW(buffer.at(100), std::out_of_range);
+    ASSERT_EQ(reinterpret_cast<std::uintptr_t>(buffer.data()) % 64, 0u);
+  }
+  std::remove(path.c_str());
+}
+
+TEST(mmap_fixed_buffer, write_modes) {
+  std::string path = temp_path("modes");
+  write_records(path, 10);
+  {
+    auto cow = utils::mmap_fixed_buffer<record>::open(
+        path, utils::mmap_mode::copy_on_write);
+    cow[0].key = 1000;
+    cow.emplace(record{11, 0, "cow"});
+    ASSERT_EQ(cow.size(), 11u);
+  }
+  {
+    auto shared = utils::mmap_fixed_buffer<record>::open(
+        path, utils::mmap_mode::read_write);
+    ASSERT_EQ(shared.size(), 10u);
+    ASSERT_EQ(shared[0].key, 0u);
+    shared[1].key = 2000;
+    shared.pop_back();
+    shared.sync();
+  }
+  auto buffer = utils::mmap_fixed_buffer<record>::open(path);
+  ASSERT_EQ(buffer.size(), 9u);
+  ASSERT_EQ(buffer[1].key, 2000u);
+  std::remove(path.c_str());
+}
+
+TEST(mmap_fixed_buffer, full) {
+  std::string path = temp_path("full");
+  auto buffer = utils::mmap_fixed_buffer<int>::create(path, 2);
+  buffer.emplace(1);
+  buffer.emplace(2);
+  ASSERT_THROW(buffer.emplace(3), std::length_error);
+  auto moved = std::move(buffer);
+  ASSERT_EQ(moved.size(), 2u);
+  ASSERT_EQ(buffer.size(), 0u);
+  std::remove(path.c_str());
+}
+
+TEST(mmap_fixed_buffer, invalid_files) {
+  ASSERT_THROW(utils::mmap_fixed_buffer<int>::open(temp_path("missing")),
+               std::system_error);
+
+  std::string path = temp_path("invalid");
+  write_records(path, 1);
+  ASSERT_THROW(utils::mmap_fixed_buffer<double>::open(path),
+               std::runtime_error);
+  {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file << std::string(200, 'x');
+  }
+  ASSERT_THROW(utils::mmap_fixed_buffer<record>::open(path),
+               std::runtime_error);
+  std::remove(path.c_str());
+}
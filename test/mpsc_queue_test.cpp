@@ -0,0 +1,118 @@
+/*
+ * tests for bounded_mpsc_queue and mpsc_queue
+ */
+
+#include "src/mpsc_queue.hpp"
+#include <gtest/gtest.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+template <typename Queue> void push(Queue &queue, int &dst, int value) {
+  queue.push([&dst, value] { dst = value; });
+}
+
+template <std::size_t N>
+void push(sg::bounded_mpsc_queue<N> &queue, int &dst, int value) {
+  while (!queue.try_push([&dst, value] { dst = value; }))
+    std::this_thread::yield();
+}
+
+template <typename Queue> void check_producers(Queue &queue) {
+  constexpr int producer_count = 4;
+  constexpr int task_count = 10000;
+  std::vector<int> last(producer_count, -1);
+  std::atomic<int> done{0};
+  bool in_order = true;
+  std::vector<std::thread> producers;
+  for (int p = 0; p < producer_count; p++)
+    producers.emplace_back([&, p] {
+      for (int i = 0; i < task_count; i++) {
+        auto task = [&, p, i] {
+          in_order &= last[p] == i - 1;
+          last[p] = i;
+        };
+        if constexpr (std::is_same_v<Queue, sg::mpsc_queue<>>)
+          queue.push(task);
+        else
+          while (!queue.try_push(task))
+            std::this_thread::yield();
+      }
+      done++;
+    });
+  while (done.load() != producer_count)
+    queue.run_all();
+  queue.run_all();
+  for (auto &t : producers)
+    t.join();
+  ASSERT_EQ(in_order, true);
+  for (int p = 0; p < producer_count; p++)
+    ASSERT_EQ(last[p], task_count - 1);
+}
+
+} // namespace
+
+TEST(mpsc_queue, bounded_basic) {
+  sg::bounded_mpsc_queue<> queue(3);
+  ASSERT_EQ(queue.capacity(), 4u);
+  int dst = 0;
+  ASSERT_EQ(queue.try_run_one(), false);
+  for (int i = 1; i <= 4; i++)
+    push(queue, dst, i);
+  ASSERT_EQ(queue.try_push([] {}), false);
+  ASSERT_EQ(queue.try_run_one(), true);
+  ASSERT_EQ(dst, 1);
+  ASSERT_EQ(queue.run_all(), 3u);
+  ASSERT_EQ(dst, 4);
+  push(queue, dst, 5);
+  ASSERT_EQ(queue.run_all(), 1u);
+  ASSERT_EQ(dst, 5);
+}
+
+TEST(mpsc_queue, unbounded_basic) {
+  sg::mpsc_queue<> queue;
+  int dst = 0;
+  ASSERT_EQ(queue.try_run_one(), false);
+  for (int i = 1; i <= 100; i++)
+    push(queue, dst, i);
+  ASSERT_EQ(queue.try_run_one(), true);
+  ASSERT_EQ(dst, 1);
+  ASSERT_EQ(queue.run_all(), 99u);
+  ASSERT_EQ(dst, 100);
+}
+
+TEST(mpsc_queue, non_sbo_tasks) {
+  std::string str = "a string that doesn't fit in the sbo of the queue";
+  std::string res;
+  sg::bounded_mpsc_queue<8> bounded(2);
+  sg::mpsc_queue<8> unbounded;
+  ASSERT_EQ(bounded.try_push([&res, str] { res += str; }), true);
+  unbounded.push([&res, str] { res += str; });
+  ASSERT_EQ(bounded.run_all(), 1u);
+  ASSERT_EQ(unbounded.run_all(), 1u);
+  ASSERT_EQ(res, str + str);
+}
+
+TEST(mpsc_queue, pending_tasks_destroyed) {
+  auto counter = std::make_shared<int>(0);
+  {
+    sg::bounded_mpsc_queue<> bounded(4);
+    sg::mpsc_queue<> unbounded;
+    bounded.try_push([counter] {});
+    unbounded.push([counter] {});
+    ASSERT_EQ(counter.use_count(), 3);
+  }
+  ASSERT_EQ(counter.use_count(), 1);
+}
+
+TEST(mpsc_queue, bounded_producers) {
+  sg::bounded_mpsc_queue<> queue(64);
+  check_producers(queue);
+}
+
+TEST(mpsc_queue, unbounded_producers) {
+  sg::mpsc_queue<> queue;
+  check_producers(queue);
+}
@@ -0,0 +1,100 @@
+/*
+ * tests for segmented_buffer
+ */
+
+#include "src/StackedBumpAllocator.hpp"
+#include "src/segmented_buffer.hpp"
+#include <atomic>
+#include <gtest/gtest.h>
+#include <mutex>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct pinned {
+  static inline int alive = 0;
+  std::mutex lock;
+  int value;
+  explicit pinned(int v) : value{v} { alive++; }
+  pinned(const pinned &) = delete;
+  ~pinned() { alive--; }
+};
+
+} // namespace
+
+TEST(segmented_buffer, stable_addresses) {
+  {
+    utils::segmented_buffer<pinned, 4> buffer;
+    std::vector<pinned *> addresses;
+    for (int i = 0; i < 1000; i++)
+      addresses.push_back(&buffer.emplace(i));
+    ASSERT_EQ(buffer.size(), 1000u);
+    ASSERT_GE(buffer.capacity(), 1000u);
+    for (int i = 0; i < 1000; i++) {
+      ASSERT_EQ(&buffer[i], addresses[i]);
+      ASSERT_EQ(buffer[i].value, i);
+    }
+    ASSERT_EQ(buffer.back().value, 999);
+    ASSERT_THROW(buffer.at(1000), std::out_of_range);
+    buffer.pop_back();
+    ASSERT_EQ(pinned::alive, 999);
+  }
+  ASSERT_EQ(pinned::alive, 0);
+}
+
+TEST(segmented_buffer, chunks) {
+  utils::segmented_buffer<int, 8> buffer;
+  ASSERT_EQ(buffer.chunk_count(), 0u);
+  for (int i = 0; i < 30; i++)
+    buffer.emplace(i);
+  // chunks of 8, 16 and 32 elements
+  ASSERT_EQ(buffer.chunk_count(), 3u);
+  ASSERT_EQ(buffer.capacity(), 56u);
+  ASSERT_EQ(buffer.chunk(0).size(), 8u);
+  ASSERT_EQ(buffer.chunk(1).size(), 16u);
+  ASSERT_EQ(buffer.chunk(2).size(), 6u);
+  ASSERT_EQ(buffer.chunk(1)[0], 8);
+  ASSERT_EQ(buffer.chunk(2)[0], 24);
+  long sum = 0;
+  buffer.for_each_chunk([&](sg::span<int> chunk) {
+    sum += std::accumulate(chunk.begin(), chunk.end(), 0L);
+  });
+  ASSERT_EQ(sum, 29 * 30 / 2);
+  std::vector<int> values(buffer.begin(), buffer.end());
+  ASSERT_EQ(values.size(), 30u);
+  ASSERT_EQ(values[17], 17);
+}
+
+TEST(segmented_buffer, clear_and_reuse) {
+  utils::segmented_buffer<std::string> buffer;
+  buffer.reserve(100);
+  std::size_t capacity = buffer.capacity();
+  ASSERT_GE(capacity, 100u);
+  for (int i = 0; i < 100; i++)
+    buffer.emplace(std::to_string(i));
+  buffer.clear();
+  ASSERT_TRUE(buffer.empty());
+  ASSERT_EQ(buffer.capacity(), capacity);
+  buffer.emplace("again");
+  ASSERT_EQ(buffer.front(), "again");
+
+  utils::segmented_buffer<std::string> moved(std::move(buffer));
+  ASSERT_EQ(moved.size(), 1u);
+  ASSERT_EQ(buffer.size(), 0u);
+  buffer = std::move(moved);
+  ASSERT_EQ(buffer[0], "again");
+}
+
+TEST(segmented_buffer, arena_chunks) {
+  using arena_type = llvm::BumpPtrAllocatorImpl<>;
+  using allocator = utils::arena_allocator<arena_type>;
+  arena_type arena;
+  utils::segmented_buffer<long, 16, allocator> buffer{allocator(arena)};
+  for (long i = 0; i < 100; i++)
+    buffer.emplace(i);
+  ASSERT_EQ(buffer[99], 99);
+  ASSERT_EQ(arena.getBytesAllocated(), buffer.capacity() * sizeof(long));
+}
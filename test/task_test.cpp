@@ -0,0 +1,175 @@
+/*
+ * tests for task, built as C++20
+ */
+
+#include "src/task.hpp"
+#include "src/StackedBumpAllocator.hpp"
+#include <gtest/gtest.h>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+/// suspend until resume_all is called.
+struct event {
+  std::vector<std::coroutine_handle<>> waiters;
+  bool await_ready() const noexcept { return false; }
+  void await_suspend(std::coroutine_handle<> h) { waiters.push_back(h); }
+  void await_resume() const noexcept {}
+  void resume_all() {
+    auto list = std::move(waiters);
+    for (auto h : list)
+      h.resume();
+  }
+};
+
+sg::task<int> value(int v) { co_return v; }
+
+sg::task<int> add(int a, int b) { co_return co_await value(a) + b; }
+
+sg::task<long> sum(int n) {
+  long total = 0;
+  for (int i = 0; i < n; i++)
+    total += co_await value(i);
+  co_return total;
+}
+
+sg::task<int> wait_for(event &e, int v) {
+  co_await e;
+  co_return v;
+}
+
+sg::task<> fail() {
+  throw std::runtime_error("fail");
+  co_return;
+}
+
+sg::task<std::string> text(const char *str) { co_return str; }
+
+} // namespace
+
+TEST(task, lazy) {
+  bool started = false;
+  auto body = [&]() -> sg::task<> {
+    started = true;
+    co_return;
+  };
+  sg::task<> t = body();
+  ASSERT_FALSE(started);
+  ASSERT_FALSE(t.done());
+  t.start();
+  ASSERT_TRUE(started);
+  ASSERT_TRUE(t.done());
+}
+
+TEST(task, result) {
+  ASSERT_EQ(sg::sync_wait(add(1, 2)), 3);
+  ASSERT_EQ(sg::sync_wait(text("hello")), "hello");
+  sg::task<int> t = value(4);
+  ASSERT_EQ(sg::sync_wait(t), 4);
+}
+
+TEST(task, exception) {
+  ASSERT_THROW(sg::sync_wait(fail()), std::runtime_error);
+  auto outer = []() -> sg::task<int> {
+    try {
+      co_await fail();
+    } catch (const std::runtime_error &) {
+      co_return 1;
+    }
+    co_return 0;
+  };
+  ASSERT_EQ(sg::sync_wait(outer()), 1);
+}
+
+TEST(task, symmetric_transfer) {
+  // every await completes synchronously, without symmetric transfer this
+  // would use one stack frame per iteration
+  constexpr int count = 1000000;
+  ASSERT_EQ(sg::sync_wait(sum(count)), long(count) * (count - 1) / 2);
+}
+
+TEST(task, start_callback) {
+  event e;
+  int result = 0;
+  sg::task<int> t = wait_for(e, 7);
+  t.start([&] { result = t.result(); });
+  ASSERT_FALSE(t.done());
+  ASSERT_EQ(result, 0);
+  e.resume_all();
+  ASSERT_TRUE(t.done());
+  ASSERT_EQ(result, 7);
+}
+
+TEST(task, continuation) {
+  event e;
+  auto outer = [&]() -> sg::task<int> {
+    int a = co_await wait_for(e, 1);
+    int b = co_await wait_for(e, 2);
+    co_return a + b;
+  };
+  sg::task<int> t = outer();
+  bool finished = false;
+  t.start([&] { finished = true; });
+  e.resume_all();
+  ASSERT_FALSE(finished);
+  e.resume_all();
+  ASSERT_TRUE(finished);
+  ASSERT_EQ(t.result(), 3);
+}
+
+TEST(task, resume_on_other_thread) {
+  event e;
+  std::thread resumer;
+  auto body = [&]() -> sg::task<int> {
+    struct {
+      std::thread &resumer;
+      bool await_ready() const noexcept { return false; }
+      void await_suspend(std::coroutine_handle<> h) {
+        resumer = std::thread([h] { h.resume(); });
+      }
+      void await_resume() const noexcept {}
+    } switch_thread{resumer};
+    co_await switch_thread;
+    co_return 5;
+  };
+  ASSERT_EQ(sg::sync_wait(body()), 5);
+  resumer.join();
+}
+
+TEST(task, frame_pool) {
+  // frames are recycled, so the same block is reused by the next frame of
+  // the same size
+  auto probe = []() -> sg::task<void *> {
+    struct {
+      void *frame = nullptr;
+      bool await_ready() const noexcept { return false; }
+      bool await_suspend(std::coroutine_handle<> h) noexcept {
+        frame = h.address();
+        return false;
+      }
+      void *await_resume() const noexcept { return frame; }
+    } self;
+    co_return co_await self;
+  };
+  void *first = sg::sync_wait(probe());
+  void *second = sg::sync_wait(probe());
+  ASSERT_EQ(first, second);
+}
+
+TEST(task, frame_arena) {
+  llvm::StackedBumpAllocator<> arena;
+  arena.PushFrame();
+  std::size_t before = arena.getBytesAllocated();
+  {
+    sg::task_frame_arena<llvm::StackedBumpAllocator<>> scope(arena);
+    ASSERT_EQ(sg::sync_wait(add(2, 3)), 5);
+  }
+  ASSERT_GT(arena.getBytesAllocated(), before);
+  std::size_t after = arena.getBytesAllocated();
+  ASSERT_EQ(sg::sync_wait(add(2, 3)), 5);
+  ASSERT_EQ(arena.getBytesAllocated(), after);
+  arena.PopFrame();
+}
@@ -0,0 +1,121 @@
+/*
+ * tests for thread_pool
+ */
+
+#include "src/thread_pool.hpp"
+#include "src/StackedBumpAllocator.hpp"
+#include <gtest/gtest.h>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+long fib(sg::thread_pool<> &pool, int n) {
+  if (n < 2)
+    return n;
+  long a = 0;
+  sg::task_group group;
+  pool.spawn(group, [&pool, &a, n] { a = fib(pool, n - 1); });
+  long b = fib(pool, n - 2);
+  pool.wait(group);
+  return a + b;
+}
+
+} // namespace
+
+TEST(thread_pool, spawn_wait) {
+  sg::thread_pool<> pool(4);
+  std::atomic<int> count{0};
+  sg::task_group group;
+  for (int i = 0; i < 1000; i++)
+    pool.spawn(group, [&] { count++; });
+  pool.wait(group);
+  ASSERT_EQ(count.load(), 1000);
+}
+
+TEST(thread_pool, parallel_for) {
+  sg::thread_pool<> pool(4);
+  std::vector<int> values(100000, 0);
+  pool.parallel_for(0, values.size(), 128, [&](std::size_t i) {
+    values[i] = int(i % 7);
+  });
+  long expected = 0;
+  for (std::size_t i = 0; i < values.size(); i++)
+    expected += i % 7;
+  ASSERT_EQ(std::accumulate(values.begin(), values.end(), 0l), expected);
+}
+
+TEST(thread_pool, parallel_for_exception) {
+  sg::thread_pool<> pool(4);
+  std::atomic<int> count{0};
+  // index 0 runs on the calling thread after the other chunks are spawned
+  ASSERT_THROW(pool.parallel_for(0, 10000, 16,
+                                 [&](std::size_t i) {
+                                   if (i == 0)
+                                     throw std::runtime_error("failed");
+                                   count++;
+                                 }),
+               std::runtime_error);
+  // only the rest of the first chunk is skipped
+  ASSERT_LT(count.load(), 10000);
+  ASSERT_GE(count.load(), 10000 - 16);
+}
+
+TEST(thread_pool, throwing_copy) {
+  struct bad_copy {
+    bad_copy() = default;
+    bad_copy(const bad_copy &) { throw std::runtime_error("copy"); }
+    bad_copy(bad_copy &&) noexcept = default;
+    void operator()() noexcept {}
+  };
+  bad_copy task;
+  {
+    sg::thread_pool<> pool(2);
+    sg::task_group group;
+    ASSERT_THROW(pool.spawn(group, task), std::runtime_error);
+    ASSERT_THROW(pool.spawn(task), std::runtime_error);
+    // neither the group nor the pool count the tasks that failed
+    pool.wait(group);
+  }
+}
+
+TEST(thread_pool, nested_fork_join) {
+  sg::thread_pool<> pool(3, 64);
+  ASSERT_EQ(fib(pool, 20), 6765);
+}
+
+TEST(thread_pool, exception) {
+  sg::thread_pool<> pool(2);
+  sg::task_group group;
+  std::atomic<int> count{0};
+  for (int i = 0; i < 10; i++)
+    pool.spawn(group, [&, i] {
+      count++;
+      if (i == 5)
+        throw std::runtime_error("task failed");
+    });
+  ASSERT_THROW(pool.wait(group), std::runtime_error);
+  ASSERT_EQ(count.load(), 10);
+  pool.spawn(group, [&] { count++; });
+  pool.wait(group);
+  ASSERT_EQ(count.load(), 11);
+}
+
+TEST(thread_pool, scratch_allocator) {
+  sg::thread_pool<32, llvm::StackedBumpAllocator<>> pool(2);
+  ASSERT_EQ(pool.scratch(), nullptr);
+  std::atomic<int> ok{0};
+  sg::task_group group;
+  for (int i = 0; i < 100; i++)
+    pool.spawn(group, [&] {
+      auto *scratch = pool.scratch();
+      if (!scratch || scratch->HasNoFrame())
+        return;
+      auto *data = static_cast<int *>(scratch->Allocate(64, alignof(int)));
+      data[0] = 1;
+      ok += data[0];
+    });
+  pool.wait(group);
+  ASSERT_EQ(ok.load(), 100);
+}